@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "bench.h"
+
+#define ALLOC_BATCH 1024   // number of chunks allocated before they are all freed again
+#define ALLOC_OPS 400000  // number of allocations per run
+#define ALLOC_MAPPED_BATCH 32768 // number of chunks allocated into each array that is mapped on its own
+#define ALLOC_INTERIOR_OFFSET 1  // number of words of the older chunk that come before the array its batch is allocated into
+#define ALLOC_INTERIOR_ROUNDS 2  // number of batches allocated into an older chunk per run, each of which waits for two collections
+
+static const size_t g_sizes[] = {16, 64, 256, 1024, 4096};
+
+static size_t run(bench_variant variant, size_t size, bool explicit_free, bool batched);
+static size_t run_mapped(size_t size);
+static size_t run_interior(size_t size);
+
+void bench_alloc_free(void)
+{
+    size_t i, ops;
+    bench_variant variant;
+    bench_run run_info;
+
+    for (i = 0; i < sizeof(g_sizes) / sizeof(g_sizes[0]); i++)
+    {
+        for (variant = BENCH_MALLOC; variant <= BENCH_GCLIB_SLAB; variant++)
+        {
+            bench_begin(&run_info, "alloc", variant, "size=%zu,free=explicit", g_sizes[i]);
+            ops = run(variant, g_sizes[i], true, false);
+            bench_end(&run_info, ops);
+        }
+
+        // Leaving the chunks to the collector instead is what a garbage-collected program would normally do
+        for (variant = BENCH_GCLIB; variant < BENCH_VARIANTS; variant++)
+        {
+            bench_begin(&run_info, "alloc", variant, "size=%zu,free=collector", g_sizes[i]);
+            ops = run(variant, g_sizes[i], false, false);
+            bench_end(&run_info, ops);
+
+            bench_begin(&run_info, "alloc", variant, "size=%zu,free=collector,batch=%d", g_sizes[i], ALLOC_BATCH);
+            ops = run(variant, g_sizes[i], false, true);
+            bench_end(&run_info, ops);
+
+            bench_begin(&run_info, "alloc", variant, "size=%zu,free=collector,batch=%d,out=mmap", g_sizes[i], ALLOC_MAPPED_BATCH);
+            ops = run_mapped(g_sizes[i]);
+            bench_end(&run_info, ops);
+
+            bench_begin(&run_info, "alloc", variant, "size=%zu,free=collector,batch=%d,out=interior", g_sizes[i], ALLOC_BATCH);
+            ops = run_interior(g_sizes[i]);
+            bench_end(&run_info, ops);
+        }
+    }
+
+    return;
+}
+
+/* Allocate chunks of `size` bytes in batches (with a single call to `gclib_alloc_batch()` for each if `batched`), freeing each batch (or dropping it) before the next. Return the number of allocations and frees made. */
+static size_t run(bench_variant variant, size_t size, bool explicit_free, bool batched)
+{
+    size_t i, j, ops = 0;
+    void *batch[ALLOC_BATCH];
+
+    for (i = 0; i < ALLOC_OPS * g_bench_scale / ALLOC_BATCH; i++)
+    {
+        if (batched && gclib_alloc_batch(ALLOC_BATCH, size, false, batch) != ALLOC_BATCH) // the entries after a short batch would be left uninitialized
+        {
+            abort();
+        }
+
+        for (j = 0; j < ALLOC_BATCH; j++)
+        {
+            if (!batched)
+            {
+                batch[j] = bench_alloc(variant, size, false);
+            }
+
+            *(volatile char *) batch[j] = 0; // touch the chunk so that it is at least as costly as any real use
+        }
+
+        ops += ALLOC_BATCH;
+        if (explicit_free)
+        {
+            for (j = 0; j < ALLOC_BATCH; j++)
+            {
+                bench_free(variant, batch[j]);
+            }
+
+            ops += ALLOC_BATCH;
+        }
+    }
+
+    return ops;
+}
+
+/* Allocate chunks of `size` bytes with `gclib_alloc_batch()` into arrays that are mapped for it and unmapped right after (since `free()` may keep memory mapped), then one at a time until generation 0 was collected twice, which would fault if a collection still scanned any of the arrays. Return the number of allocations made. */
+static size_t run_mapped(size_t size)
+{
+    size_t i, j, ops = 0;
+    void **p_batch;
+    gclib_stats stats;
+    unsigned long collections;
+
+    for (i = 0; i < ALLOC_OPS * g_bench_scale / ALLOC_MAPPED_BATCH; i++)
+    {
+        p_batch = mmap(NULL, ALLOC_MAPPED_BATCH * sizeof(void *), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p_batch == MAP_FAILED || gclib_alloc_batch(ALLOC_MAPPED_BATCH, size, false, p_batch) != ALLOC_MAPPED_BATCH)
+        {
+            abort();
+        }
+
+        for (j = 0; j < ALLOC_MAPPED_BATCH; j++)
+        {
+            *(volatile char *) p_batch[j] = 0;
+        }
+
+        munmap(p_batch, ALLOC_MAPPED_BATCH * sizeof(void *));
+        ops += ALLOC_MAPPED_BATCH;
+    }
+
+    gclib_get_stats(&stats);
+    collections = stats.gens[0].collections;
+    while (stats.gens[0].collections < collections + 2) // the first may have been under way already
+    {
+        for (j = 0; j < ALLOC_BATCH; j++)
+        {
+            *(volatile char *) gclib_alloc(size, false) = 0;
+        }
+
+        ops += ALLOC_BATCH;
+        gclib_get_stats(&stats);
+    }
+
+    return ops;
+}
+
+/* Allocate chunks of `size` bytes with `gclib_alloc_batch()` into an array in the middle of a chunk that was promoted out of generation 0, then one at a time until generation 0 was collected twice, and abort if any chunk of the batch was freed although that array still references it. Repeat `ALLOC_INTERIOR_ROUNDS` times. Return the number of allocations made. */
+static size_t run_interior(size_t size)
+{
+    size_t i, j, ops = 0;
+    void **p_outer;
+    gclib_weak *weak[ALLOC_BATCH];
+    gclib_stats stats;
+    unsigned long collections;
+
+    for (i = 0; i < ALLOC_INTERIOR_ROUNDS * g_bench_scale; i++)
+    {
+        p_outer = gclib_alloc((ALLOC_INTERIOR_OFFSET + ALLOC_BATCH) * sizeof(void *), true);
+        if (p_outer == NULL)
+        {
+            abort();
+        }
+
+        gclib_force_collect(); // promotes it, so that collections of generation 0 only scan what was remembered of it
+        if (gclib_alloc_batch(ALLOC_BATCH, size, false, p_outer + ALLOC_INTERIOR_OFFSET) != ALLOC_BATCH)
+        {
+            abort();
+        }
+
+        for (j = 0; j < ALLOC_BATCH; j++)
+        {
+            weak[j] = gclib_weak_create(p_outer[ALLOC_INTERIOR_OFFSET + j]);
+            if (weak[j] == NULL)
+            {
+                abort();
+            }
+        }
+
+        ops += ALLOC_BATCH;
+        gclib_get_stats(&stats);
+        collections = stats.gens[0].collections;
+        while (stats.gens[0].collections < collections + 2) // the first may have been under way already
+        {
+            for (j = 0; j < ALLOC_BATCH; j++)
+            {
+                *(volatile char *) gclib_alloc(size, false) = 0;
+            }
+
+            ops += ALLOC_BATCH;
+            gclib_get_stats(&stats);
+        }
+
+        for (j = 0; j < ALLOC_BATCH; j++)
+        {
+            if (gclib_weak_get(weak[j]) != p_outer[ALLOC_INTERIOR_OFFSET + j])
+            {
+                abort();
+            }
+
+            gclib_weak_free(weak[j]);
+        }
+    }
+
+    return ops;
+}
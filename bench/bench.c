@@ -0,0 +1,210 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+unsigned int g_bench_scale = 1; // what every benchmark multiplies its number of iterations by, to get steadier results
+const char *g_bench_variant_names[BENCH_VARIANTS] = {"malloc", "gclib", "gclib-slab", "gclib-incremental", "gclib-concurrent"}; // names printed for each variant
+
+static const bench g_benches[] = {
+    {"alloc", bench_alloc_free},
+    {"pause", bench_pause},
+    {"trees", bench_trees},
+    {"lists", bench_lists},
+    {"buffers", bench_buffers},
+    {"realloc", bench_realloc_growth},
+    {"requests", bench_requests},
+    {"tables", bench_tables},
+    {"threads", bench_threads},
+};
+
+static void usage(const char *name);
+static void configure(bench_variant variant);
+
+int main(int argc, char **argv)
+{
+    size_t i, j;
+    bool selected[sizeof(g_benches) / sizeof(g_benches[0])] = {false};
+    bool any = false;
+
+    for (i = 1; i < (size_t) argc; i++)
+    {
+        if (strcmp(argv[i], "-l") == 0)
+        {
+            g_bench_scale = 10;
+            continue;
+        }
+
+        for (j = 0; j < sizeof(g_benches) / sizeof(g_benches[0]); j++)
+        {
+            if (strcmp(argv[i], g_benches[j].name) == 0)
+            {
+                selected[j] = any = true;
+                break;
+            }
+        }
+
+        if (j == sizeof(g_benches) / sizeof(g_benches[0]))
+        {
+            usage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    gclib_init();
+    for (i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++)
+    {
+        if (!any || selected[i])
+        {
+            g_benches[i].run();
+        }
+    }
+
+    gclib_cleanup();
+
+    return EXIT_SUCCESS;
+}
+
+void bench_begin(bench_run *p_run, const char *name, bench_variant variant, const char *param_fmt, ...)
+{
+    va_list args;
+
+    p_run->name = name;
+    p_run->variant = variant;
+    va_start(args, param_fmt);
+    vsnprintf(p_run->param, sizeof(p_run->param), param_fmt, args);
+    va_end(args);
+
+    // Leave nothing from the previous run behind for this one to collect, and start from the same settings each time
+    gclib_force_collect();
+    configure(variant);
+    gclib_reset_pause_stats(); // so that the longest pause is this run's own
+    gclib_get_stats(&p_run->start_stats);
+    p_run->start_ns = bench_now_ns();
+
+    return;
+}
+
+void bench_end(bench_run *p_run, size_t ops)
+{
+    uint64_t ns;
+    gclib_stats end_stats;
+    const gclib_stats *p_start = &p_run->start_stats;
+
+    ns = bench_now_ns() - p_run->start_ns;
+    gclib_get_stats(&end_stats);
+    if (p_run->variant == BENCH_MALLOC)
+    {
+        end_stats = *p_start;
+    }
+
+    printf("{\"bench\": \"%s\", \"variant\": \"%s\", \"param\": \"%s\", \"ops\": %zu, \"seconds\": %.6f, "
+           "\"ops_per_sec\": %.0f, \"collections\": %lu, \"full_collections\": %lu, \"pauses\": %lu, "
+           "\"pause_total_ms\": %.3f, \"pause_max_ms\": %.3f}\n",
+           p_run->name, g_bench_variant_names[p_run->variant], p_run->param, ops, ns / 1e9,
+           ns ? ops / (ns / 1e9) : 0.0, end_stats.gens[0].collections - p_start->gens[0].collections,
+           end_stats.gens[end_stats.generations - 1].collections - p_start->gens[end_stats.generations - 1].collections,
+           end_stats.pauses - p_start->pauses, (end_stats.pause_ns_total - p_start->pause_ns_total) / 1e6,
+           end_stats.pause_ns_max / 1e6);
+    fflush(stdout);
+
+    return;
+}
+
+void *bench_alloc(bench_variant variant, size_t size, bool zeroed)
+{
+    if (variant == BENCH_MALLOC)
+    {
+        return zeroed ? calloc(1, size) : malloc(size);
+    }
+
+    return gclib_alloc(size, zeroed);
+}
+
+void *bench_alloc_atomic(bench_variant variant, size_t size)
+{
+    if (variant == BENCH_MALLOC)
+    {
+        return malloc(size);
+    }
+
+    return gclib_alloc_atomic(size, false);
+}
+
+void *bench_realloc(bench_variant variant, void *ptr, size_t size)
+{
+    if (variant == BENCH_MALLOC)
+    {
+        return realloc(ptr, size);
+    }
+
+    return gclib_realloc(ptr, size);
+}
+
+void bench_free(bench_variant variant, void *ptr)
+{
+    if (variant == BENCH_MALLOC)
+    {
+        free(ptr);
+    }
+    else
+    {
+        gclib_free(ptr);
+    }
+
+    return;
+}
+
+void bench_write_ptr(bench_variant variant, void *dst, void *val)
+{
+    if (variant == BENCH_MALLOC)
+    {
+        *(void **) dst = val;
+    }
+    else
+    {
+        gclib_write_ptr(dst, val);
+    }
+
+    return;
+}
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+    size_t i;
+
+    fprintf(stderr, "usage: %s [-l] [benchmark...]\n\n", name);
+    fprintf(stderr, "  -l  run ten times the iterations\n\nbenchmarks (all by default):");
+    for (i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++)
+    {
+        fprintf(stderr, " %s", g_benches[i].name);
+    }
+
+    fprintf(stderr, "\n");
+
+    return;
+}
+
+static void configure(bench_variant variant)
+{
+    gclib_set_gen_budget(0, BENCH_GEN_BUDGET);
+    gclib_set_slab_alloc(variant >= BENCH_GCLIB_SLAB);
+    gclib_set_pause_target(variant == BENCH_GCLIB_INCREMENTAL ? BENCH_PAUSE_TARGET : 0);
+    gclib_set_concurrent(variant == BENCH_GCLIB_CONCURRENT);
+    gclib_set_mark_threads(1);
+
+    return;
+}
@@ -0,0 +1,97 @@
+#ifndef GCLIB_BENCH_H
+#define GCLIB_BENCH_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gclib.h"
+
+#define BENCH_GEN_BUDGET (16 << 20) // budget of generation 0 for every `gclib` variant, so that collections happen within a run
+#define BENCH_PAUSE_TARGET 100      // pause target (in microseconds) of the incremental variant
+
+/* How memory is managed during a run. */
+typedef enum bench_variant
+{
+    BENCH_MALLOC,            // `malloc()` and `free()` directly, as a baseline
+    BENCH_GCLIB,             // `gclib` with its default settings
+    BENCH_GCLIB_SLAB,        // `gclib` with slab allocation
+    BENCH_GCLIB_INCREMENTAL, // `gclib` with slab allocation and incremental marking
+    BENCH_GCLIB_CONCURRENT,  // `gclib` with slab allocation and concurrent marking
+    BENCH_VARIANTS
+} bench_variant;
+
+/* A measurement in progress, started by `bench_begin()` and reported by `bench_end()`. */
+typedef struct bench_run
+{
+    const char *name;
+    bench_variant variant;
+    char param[96];          // what the run was parameterized with, as `key=value` pairs separated by commas
+    uint64_t start_ns;
+    gclib_stats start_stats; // statistics when the run started, which are subtracted from those when it ends
+} bench_run;
+
+/* A benchmark that can be selected on the command line. */
+typedef struct bench
+{
+    const char *name;
+    void (*run)(void);
+} bench;
+
+extern unsigned int g_bench_scale;
+extern const char *g_bench_variant_names[BENCH_VARIANTS];
+
+/* Configure `gclib` for `variant` and start measuring a run of the benchmark `name`, described by `param_fmt` and the arguments after it (as with `printf()`). */
+void bench_begin(bench_run *p_run, const char *name, bench_variant variant, const char *param_fmt, ...);
+
+/* Stop measuring the run and print its results as a single line of JSON, where `ops` is the number of operations the run performed. */
+void bench_end(bench_run *p_run, size_t ops);
+
+/* Allocate `size` bytes the way `variant` manages memory. */
+void *bench_alloc(bench_variant variant, size_t size, bool zeroed);
+
+/* Allocate `size` bytes that never hold references the way `variant` manages memory. */
+void *bench_alloc_atomic(bench_variant variant, size_t size);
+
+/* Resize a chunk allocated by `bench_alloc()` the way `variant` manages memory. */
+void *bench_realloc(bench_variant variant, void *ptr, size_t size);
+
+/* Free a chunk allocated by `bench_alloc()` explicitly, which `gclib` variants may also leave to the collector. */
+void bench_free(bench_variant variant, void *ptr);
+
+/* Store `val` into the word at `dst`, through `gclib_write_ptr()` for `gclib` variants. */
+void bench_write_ptr(bench_variant variant, void *dst, void *val);
+
+/* Return the current time of the monotonic clock in nanoseconds. */
+uint64_t bench_now_ns(void);
+
+/* Measure `gclib_alloc()`/`gclib_free()` throughput against `malloc()`/`free()` for a range of sizes. */
+void bench_alloc_free(void);
+
+/* Measure collection pauses against the size of the live heap. */
+void bench_pause(void);
+
+/* Build and check binary trees of short-lived nodes next to a long-lived tree. */
+void bench_trees(void);
+
+/* Build rings of list nodes that reference each other and drop them. */
+void bench_lists(void);
+
+/* Fill and drop large pointer-free buffers. */
+void bench_buffers(void);
+
+/* Grow many arrays one element (or one doubling) at a time through `realloc()`. */
+void bench_realloc_growth(void);
+
+/* Build the short-lived objects of many requests, as chunks and from a region per request. */
+void bench_requests(void);
+
+/* Keep a large typed table of references to small records and compact the heap while replacing some of them. */
+void bench_tables(void);
+
+/* Build and check lists from several registered threads at once. */
+void bench_threads(void);
+
+
+#endif // GCLIB_BENCH_H
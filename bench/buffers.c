@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define BUFFERS_LIVE 16        // number of buffers that are live at a time
+#define BUFFERS_BYTES (128 << 20) // total size of the buffers allocated per run
+
+static const size_t g_sizes[] = {64 << 10, 1 << 20};
+static void *g_buffers[BUFFERS_LIVE]; // the live buffers, reachable through the data segment
+
+static size_t run(bench_variant variant, size_t size, bool atomic);
+
+void bench_buffers(void)
+{
+    size_t i, ops;
+    bench_variant variant;
+    bench_run run_info;
+
+    // Large buffers full of data that looks like pointers cost a scanned heap every time it's collected (and may keep
+    // garbage alive by chance), while atomic ones are never scanned
+    for (i = 0; i < sizeof(g_sizes) / sizeof(g_sizes[0]); i++)
+    {
+        bench_begin(&run_info, "buffers", BENCH_MALLOC, "size=%zu", g_sizes[i]);
+        ops = run(BENCH_MALLOC, g_sizes[i], false);
+        bench_end(&run_info, ops);
+        for (variant = BENCH_GCLIB; variant <= BENCH_GCLIB_SLAB; variant++)
+        {
+            bench_begin(&run_info, "buffers", variant, "size=%zu,atomic=0", g_sizes[i]);
+            ops = run(variant, g_sizes[i], false);
+            bench_end(&run_info, ops);
+            bench_begin(&run_info, "buffers", variant, "size=%zu,atomic=1", g_sizes[i]);
+            ops = run(variant, g_sizes[i], true);
+            bench_end(&run_info, ops);
+        }
+    }
+
+    return;
+}
+
+/* Allocate and fill buffers of `size` bytes, each of which replaces the oldest live one. Return the number of buffers allocated. */
+static size_t run(bench_variant variant, size_t size, bool atomic)
+{
+    size_t i, slot, count;
+    unsigned char *p_buffer;
+
+    count = (size_t) BUFFERS_BYTES * g_bench_scale / size;
+    for (i = 0; i < count; i++)
+    {
+        slot = i % BUFFERS_LIVE;
+        if (variant == BENCH_MALLOC)
+        {
+            free(g_buffers[slot]);
+        }
+
+        p_buffer = atomic ? bench_alloc_atomic(variant, size) : bench_alloc(variant, size, false);
+        memset(p_buffer, (int) i, size);
+        g_buffers[slot] = p_buffer;
+    }
+
+    for (slot = 0; slot < BUFFERS_LIVE; slot++)
+    {
+        if (variant == BENCH_MALLOC)
+        {
+            free(g_buffers[slot]);
+        }
+
+        g_buffers[slot] = NULL;
+    }
+
+    return count;
+}
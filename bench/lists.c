@@ -0,0 +1,122 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define LISTS_RINGS 256     // number of rings that are live at a time
+#define LISTS_RING_LEN 64   // number of nodes per ring
+#define LISTS_BUILT 20000  // number of rings built per run
+
+typedef struct list_node
+{
+    struct list_node *p_next;
+    struct list_node *p_across; // the node half-way around the ring, so that each ring holds many cycles
+    long value;
+} list_node;
+
+static list_node *g_rings[LISTS_RINGS]; // the live rings, reachable through the data segment
+
+static list_node *build(bench_variant variant, long value);
+static long sum(const list_node *p_ring);
+static void destroy(bench_variant variant, list_node *p_ring);
+
+void bench_lists(void)
+{
+    size_t i, slot;
+    long total;
+    bench_variant variant;
+    bench_run run_info;
+
+    // Rings are unreachable as a whole but every node in them is still referenced, which reference counting couldn't
+    // free; the collector (or, as a baseline, explicit frees) must
+    for (variant = BENCH_MALLOC; variant < BENCH_VARIANTS; variant++)
+    {
+        bench_begin(&run_info, "lists", variant, "rings=%d,ring_len=%d", LISTS_RINGS, LISTS_RING_LEN);
+        total = 0;
+        for (i = 0; i < LISTS_BUILT * g_bench_scale; i++)
+        {
+            slot = (i * 7919) % LISTS_RINGS;
+            if (g_rings[slot] != NULL)
+            {
+                total += sum(g_rings[slot]);
+                if (variant == BENCH_MALLOC)
+                {
+                    destroy(variant, g_rings[slot]);
+                }
+            }
+
+            g_rings[slot] = build(variant, (long) i);
+        }
+
+        for (slot = 0; slot < LISTS_RINGS; slot++)
+        {
+            if (g_rings[slot] != NULL && variant == BENCH_MALLOC)
+            {
+                destroy(variant, g_rings[slot]);
+            }
+
+            g_rings[slot] = NULL;
+        }
+
+        bench_end(&run_info, i * LISTS_RING_LEN);
+        if (total < 0)
+        {
+            abort();
+        }
+    }
+
+    return;
+}
+
+/* Build a ring of `LISTS_RING_LEN` nodes holding `value`, and return its first node. */
+static list_node *build(bench_variant variant, long value)
+{
+    size_t i;
+    list_node *nodes[LISTS_RING_LEN];
+
+    for (i = 0; i < LISTS_RING_LEN; i++)
+    {
+        nodes[i] = bench_alloc(variant, sizeof(list_node), false);
+        nodes[i]->value = value;
+    }
+
+    for (i = 0; i < LISTS_RING_LEN; i++)
+    {
+        bench_write_ptr(variant, &nodes[i]->p_next, nodes[(i + 1) % LISTS_RING_LEN]);
+        bench_write_ptr(variant, &nodes[i]->p_across, nodes[(i + LISTS_RING_LEN / 2) % LISTS_RING_LEN]);
+    }
+
+    return nodes[0];
+}
+
+/* Return the sum of the values of the nodes in a ring, following both kinds of links. */
+static long sum(const list_node *p_ring)
+{
+    long total = 0;
+    const list_node *p_node = p_ring;
+
+    do
+    {
+        total += p_node->value + p_node->p_across->value;
+        p_node = p_node->p_next;
+    } while (p_node != p_ring);
+
+    return total;
+}
+
+/* Free every node of a ring. */
+static void destroy(bench_variant variant, list_node *p_ring)
+{
+    list_node *p_node, *p_next;
+
+    p_node = p_ring->p_next;
+    while (p_node != p_ring)
+    {
+        p_next = p_node->p_next;
+        bench_free(variant, p_node);
+        p_node = p_next;
+    }
+
+    bench_free(variant, p_ring);
+
+    return;
+}
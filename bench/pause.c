@@ -0,0 +1,110 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define PAUSE_CHURN 400000  // number of short-lived nodes allocated per run
+#define PAUSE_KEEP_EVERY 16 // one in this many short-lived nodes replaces the payload of a live node
+
+typedef struct pause_node
+{
+    struct pause_node *p_next;
+    struct pause_node *p_payload;
+    long value;
+} pause_node;
+
+static const size_t g_live_nodes[] = {1 << 13, 1 << 15, 1 << 17};
+static const unsigned int g_mark_threads[] = {1, 2, 4}; // only for the variants that mark all at once, whose pauses are all marking
+static pause_node *g_p_live; // the live list, reachable through the data segment
+
+static void mark_threads(unsigned int threads);
+static void build(bench_variant variant, size_t nodes);
+static size_t churn(bench_variant variant);
+
+void bench_pause(void)
+{
+    size_t i, j, nodes, ops;
+    unsigned int threads;
+    bench_variant variant;
+    bench_run run_info;
+
+    for (i = 0; i < sizeof(g_live_nodes) / sizeof(g_live_nodes[0]); i++)
+    {
+        nodes = g_live_nodes[i] * g_bench_scale;
+        for (variant = BENCH_GCLIB; variant < BENCH_VARIANTS; variant++)
+        {
+            for (j = 0; j < sizeof(g_mark_threads) / sizeof(g_mark_threads[0]); j++)
+            {
+                threads = g_mark_threads[j];
+                if (threads > 1 && variant >= BENCH_GCLIB_INCREMENTAL)
+                {
+                    break;
+                }
+
+                bench_begin(&run_info, "pause", variant, "live_nodes=%zu,live_bytes=%zu,mark_threads=%u", nodes, nodes * 2 * sizeof(pause_node), threads);
+                mark_threads(threads);
+                build(variant, nodes);
+                ops = churn(variant);
+                bench_end(&run_info, ops);
+
+                // A full collection with everything still live is the longest pause the heap can cause
+                bench_begin(&run_info, "pause-full", variant, "live_nodes=%zu,live_bytes=%zu,mark_threads=%u", nodes, nodes * 2 * sizeof(pause_node), threads);
+                mark_threads(threads);
+                gclib_force_collect();
+                bench_end(&run_info, 1);
+                g_p_live = NULL;
+            }
+        }
+    }
+
+    return;
+}
+
+/* Have collections mark on `threads` threads, which `bench_begin()` sets back to 1 for the next run. */
+static void mark_threads(unsigned int threads)
+{
+    if (!gclib_set_mark_threads(threads))
+    {
+        abort();
+    }
+
+    return;
+}
+
+/* Build a list of `nodes` nodes with one payload node each, rooted at `g_p_live`. */
+static void build(bench_variant variant, size_t nodes)
+{
+    size_t i;
+    pause_node *p_node;
+
+    g_p_live = NULL;
+    for (i = 0; i < nodes; i++)
+    {
+        p_node = bench_alloc(variant, sizeof(pause_node), true);
+        bench_write_ptr(variant, &p_node->p_payload, bench_alloc(variant, sizeof(pause_node), true));
+        bench_write_ptr(variant, &p_node->p_next, g_p_live);
+        g_p_live = p_node;
+    }
+
+    return;
+}
+
+/* Allocate short-lived nodes, keeping some of them by replacing the payloads of live nodes so that the older generations change as well. Return the number of nodes allocated. */
+static size_t churn(bench_variant variant)
+{
+    size_t i;
+    pause_node *p_node, *p_live = g_p_live;
+
+    for (i = 0; i < PAUSE_CHURN * g_bench_scale; i++)
+    {
+        p_node = bench_alloc(variant, sizeof(pause_node), false);
+        p_node->p_next = p_node->p_payload = NULL;
+        p_node->value = (long) i;
+        if (i % PAUSE_KEEP_EVERY == 0)
+        {
+            bench_write_ptr(variant, &p_live->p_payload, p_node);
+            p_live = p_live->p_next ? p_live->p_next : g_p_live;
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define REALLOC_ARRAYS 64             // number of arrays grown side by side, so that their chunks are interleaved
+#define REALLOC_ELEMENTS 16384        // number of elements each array grows to
+#define REALLOC_ROUNDS 4              // number of times every array is grown from scratch per run
+#define REALLOC_OLD_WORDS 16          // number of words of the buffer resized while the generation it is in is being marked
+#define REALLOC_OLD_MAGIC 0x5ca1ab1eL // value every word of that buffer holds
+#define REALLOC_OLD_LIST 1048576      // number of nodes in the list kept alive next to the buffer
+#define REALLOC_OLD_GARBAGE 48        // size of the chunks allocated to get collections going, which the size of the resized buffer isn't a multiple of
+
+static void **g_old_holder; // chunk that holds the resized buffer, reachable through the data segment
+static void *g_old_list;    // first node of the list kept alive next to the buffer
+
+static size_t run(bench_variant variant, bool doubling);
+static size_t run_old(void);
+static bool old_intact(void);
+
+void bench_realloc_growth(void)
+{
+    size_t ops;
+    bench_variant variant;
+    bench_run run_info;
+
+    for (variant = BENCH_MALLOC; variant <= BENCH_GCLIB_SLAB; variant++)
+    {
+        bench_begin(&run_info, "realloc", variant, "growth=element,elements=%d", REALLOC_ELEMENTS);
+        ops = run(variant, false);
+        bench_end(&run_info, ops);
+        bench_begin(&run_info, "realloc", variant, "growth=doubling,elements=%d", REALLOC_ELEMENTS);
+        ops = run(variant, true);
+        bench_end(&run_info, ops);
+    }
+
+    bench_begin(&run_info, "realloc", BENCH_GCLIB_CONCURRENT, "growth=once,gen=1,list=%d", REALLOC_OLD_LIST);
+    ops = run_old();
+    bench_end(&run_info, ops);
+
+    return;
+}
+
+/* Grow arrays of `long` one element at a time, resizing them for every element or only when they are full (doubling their capacity). Return the number of calls to `realloc()`. */
+static size_t run(bench_variant variant, bool doubling)
+{
+    size_t round, i, j, capacity, ops = 0;
+    long *arrays[REALLOC_ARRAYS];
+
+    for (round = 0; round < REALLOC_ROUNDS * g_bench_scale; round++)
+    {
+        capacity = 0;
+        for (i = 0; i < REALLOC_ARRAYS; i++)
+        {
+            arrays[i] = NULL;
+        }
+
+        for (j = 0; j < REALLOC_ELEMENTS; j++)
+        {
+            if (!doubling || j == capacity)
+            {
+                capacity = doubling ? (capacity ? capacity * 2 : 1) : j + 1;
+                for (i = 0; i < REALLOC_ARRAYS; i++)
+                {
+                    arrays[i] = bench_realloc(variant, arrays[i], capacity * sizeof(long));
+                }
+
+                ops += REALLOC_ARRAYS;
+            }
+
+            for (i = 0; i < REALLOC_ARRAYS; i++)
+            {
+                arrays[i][j] = (long) j;
+            }
+        }
+
+        for (i = 0; i < REALLOC_ARRAYS; i++)
+        {
+            if (arrays[i][REALLOC_ELEMENTS - 1] != REALLOC_ELEMENTS - 1)
+            {
+                abort();
+            }
+
+            if (variant == BENCH_MALLOC)
+            {
+                free(arrays[i]);
+            }
+        }
+    }
+
+    return ops;
+}
+
+/* Resize a buffer in generation 1, referenced only from a chunk in the same generation, while a concurrent collection of generations 0 and 1 is marking, then allocate until generation 0 was collected on its own three times. Abort if the buffer was freed or promoted out of generation 0 in the meantime, either of which means that resizing it moved it into generation 0. Return the number of allocations made. */
+static size_t run_old(void)
+{
+    size_t i, promoted, ops = 0;
+    void **p_node;
+    long *p_buffer;
+    gclib_stats stats;
+    unsigned long collections;
+
+    gclib_set_slab_alloc(false); // slab objects are never promoted
+
+    for (i = 0; i < REALLOC_OLD_LIST; i++) // keeps the background thread busy for long enough to resize the buffer
+    {
+        p_node = gclib_alloc(2 * sizeof(void *), false);
+        p_node[0] = g_old_list;
+        g_old_list = p_node;
+    }
+
+    g_old_holder = gclib_alloc(sizeof(void *), false);
+    p_buffer = gclib_alloc(REALLOC_OLD_WORDS * sizeof(long), false);
+    for (i = 0; i < REALLOC_OLD_WORDS; i++)
+    {
+        p_buffer[i] = REALLOC_OLD_MAGIC;
+    }
+
+    *g_old_holder = p_buffer;
+    p_buffer = NULL;
+    ops += REALLOC_OLD_LIST + 2;
+
+    gclib_get_stats(&stats);
+    promoted = stats.gens[0].promoted_chunks;
+    while (stats.gens[0].promoted_chunks < promoted + REALLOC_OLD_LIST + 2) // until the list, the holder and the buffer are all in generation 1
+    {
+        *(volatile char *) gclib_alloc(REALLOC_OLD_GARBAGE, false) = 0;
+        ops++;
+        gclib_get_stats(&stats);
+    }
+
+    gclib_set_growth_percent(0);
+    gclib_set_gen_budget(1, 1);
+    collections = stats.gens[1].collections;
+    while (stats.gens[1].collections == collections)
+    {
+        *(volatile char *) gclib_alloc(REALLOC_OLD_GARBAGE, false) = 0;
+        ops++;
+        gclib_get_stats(&stats);
+    }
+
+    // Otherwise the next allocation would be due to collect again, which finishes the collection under way at once
+    gclib_set_gen_budget(1, (size_t) 1e+9);
+    gclib_set_growth_percent(100);
+
+    // The holder is in generation 1, so the store doesn't need `gclib_write_ptr()` as long as the buffer is too
+    *g_old_holder = gclib_realloc(*g_old_holder, 2 * REALLOC_OLD_WORDS * sizeof(long));
+    ops++;
+
+    // A word that happens to point to the buffer (such as one the collector itself keeps in the data segment) may keep
+    // it alive even if it was moved into generation 0, but then it is promoted, which adds to the promoted bytes
+    // something that isn't a multiple of the size of the other chunks allocated from here on
+    promoted = stats.gens[0].promoted_bytes;
+    collections = stats.gens[0].collections - stats.gens[1].collections;
+    while (stats.gens[0].collections - stats.gens[1].collections < collections + 3) // only generation 0 is collected from here on, and the last collection sweeps lazily
+    {
+        if (!old_intact() || (stats.gens[0].promoted_bytes - promoted) % REALLOC_OLD_GARBAGE != 0)
+        {
+            abort();
+        }
+
+        *(volatile char *) gclib_alloc(REALLOC_OLD_GARBAGE, false) = 0;
+        ops++;
+        gclib_get_stats(&stats);
+    }
+
+    g_old_holder = NULL;
+    g_old_list = NULL;
+
+    return ops;
+}
+
+/* Return whether the buffer resized by `run_old()` still holds what was stored into it. Kept out of line so that no register of `run_old()` is left holding the buffer, which would keep it alive whatever generation it is in. */
+__attribute__((noinline)) static bool old_intact(void)
+{
+    size_t i;
+
+    for (i = 0; i < REALLOC_OLD_WORDS; i++)
+    {
+        if (((volatile long *) *g_old_holder)[i] != REALLOC_OLD_MAGIC)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define REQUESTS_SESSIONS 4096                    // number of long-lived chunks that requests refer to
+#define REQUESTS_OBJECTS 512                      // number of objects built while handling each request
+#define REQUESTS_HANDLED 4000                     // number of requests handled per run
+#define REQUESTS_WRITTEN 4                        // number of regions written to with `gclib_write_ptr()` per run
+#define REQUESTS_WRITTEN_SIZE ((size_t) 64 << 20) // size of the allocation each of them holds, which is past any threshold above which `malloc()` maps memory on its own
+
+typedef struct request_object
+{
+    struct request_object *p_next;
+    long *p_session; // the long-lived chunk the object belongs to
+    long value;
+    long pad[3];
+} request_object;
+
+static long *g_sessions[REQUESTS_SESSIONS]; // the long-lived chunks, reachable through the data segment
+
+static size_t run(bench_variant variant, bool regions);
+static request_object *handle(bench_variant variant, gclib_region *p_region, size_t request);
+static size_t run_written(void);
+
+void bench_requests(void)
+{
+    bench_variant variant;
+    bench_run run_info;
+
+    // Every object built for a request dies when the request is done, which a region frees all at once without the
+    // collector ever seeing the objects
+    for (variant = BENCH_MALLOC; variant < BENCH_VARIANTS; variant++)
+    {
+        bench_begin(&run_info, "requests", variant, "objects=%d,alloc=chunks", REQUESTS_OBJECTS);
+        bench_end(&run_info, run(variant, false));
+    }
+
+    for (variant = BENCH_GCLIB; variant < BENCH_VARIANTS; variant++)
+    {
+        bench_begin(&run_info, "requests", variant, "objects=%d,alloc=region", REQUESTS_OBJECTS);
+        bench_end(&run_info, run(variant, true));
+
+        bench_begin(&run_info, "requests", variant, "objects=1,alloc=region,store=write_ptr");
+        bench_end(&run_info, run_written());
+    }
+
+    return;
+}
+
+/* Handle `REQUESTS_HANDLED` requests, allocating their objects from a region for each if `regions`. Return the number of objects allocated. */
+static size_t run(bench_variant variant, bool regions)
+{
+    size_t i;
+    long total;
+    gclib_region *p_region;
+    request_object *p_object, *p_next;
+
+    for (i = 0; i < REQUESTS_SESSIONS; i++)
+    {
+        g_sessions[i] = bench_alloc_atomic(variant, sizeof(long));
+        *g_sessions[i] = (long) i;
+    }
+
+    total = 0;
+    for (i = 0; i < REQUESTS_HANDLED * g_bench_scale; i++)
+    {
+        p_region = regions ? gclib_region_create(true) : NULL;
+        for (p_object = handle(variant, p_region, i); p_object != NULL; p_object = p_next)
+        {
+            p_next = p_object->p_next;
+            total += p_object->value + *p_object->p_session;
+            if (variant == BENCH_MALLOC)
+            {
+                bench_free(variant, p_object);
+            }
+        }
+
+        gclib_region_destroy(p_region);
+    }
+
+    for (i = 0; i < REQUESTS_SESSIONS; i++)
+    {
+        if (variant == BENCH_MALLOC)
+        {
+            bench_free(variant, g_sessions[i]);
+        }
+
+        g_sessions[i] = NULL;
+    }
+
+    if (total < 0)
+    {
+        abort();
+    }
+
+    return (size_t) REQUESTS_HANDLED * g_bench_scale * REQUESTS_OBJECTS;
+}
+
+/* Build the objects of the request numbered `request`, from `*p_region` unless it is `NULL`, and return the first of them. */
+static request_object *handle(bench_variant variant, gclib_region *p_region, size_t request)
+{
+    size_t i;
+    request_object *p_object, *p_first;
+
+    p_first = NULL;
+    for (i = 0; i < REQUESTS_OBJECTS; i++)
+    {
+        p_object = (p_region != NULL) ? gclib_region_alloc(p_region, sizeof(request_object), false) : bench_alloc(variant, sizeof(request_object), false);
+        p_object->p_next = p_first;
+        p_object->p_session = g_sessions[(request * 31 + i) % REQUESTS_SESSIONS];
+        p_object->value = (long) i;
+        p_first = p_object;
+    }
+
+    return p_first;
+}
+
+/* Store a reference to a new chunk into a large allocation from a region with `gclib_write_ptr()` and destroy the region right after, then allocate until generation 0 was collected twice, which would fault if a collection still scanned the word that was written. Return the number of allocations made. */
+static size_t run_written(void)
+{
+    size_t i, ops = 0;
+    void **p_words;
+    gclib_region *p_region;
+    gclib_stats stats;
+    unsigned long collections;
+
+    for (i = 0; i < REQUESTS_WRITTEN; i++)
+    {
+        p_region = gclib_region_create(true);
+        p_words = (p_region != NULL) ? gclib_region_alloc(p_region, REQUESTS_WRITTEN_SIZE, false) : NULL;
+        if (p_words == NULL)
+        {
+            abort();
+        }
+
+        gclib_write_ptr(&p_words[10], gclib_alloc(sizeof(request_object), false));
+        gclib_region_destroy(p_region);
+        ops += 2;
+
+        gclib_get_stats(&stats);
+        collections = stats.gens[0].collections;
+        while (stats.gens[0].collections < collections + 2) // the first may have been under way already
+        {
+            *(volatile char *) gclib_alloc(sizeof(request_object), false) = 0;
+            ops++;
+            gclib_get_stats(&stats);
+        }
+    }
+
+    return ops;
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define TABLES_ENTRIES (1 << 18)            // number of references in the table, which makes it a large chunk (2MB)
+#define TABLES_FILLED (TABLES_ENTRIES / 10) // number of those that are filled per run (ten times as many with `-l`)
+#define TABLES_ROUNDS 16                    // number of full collections per run
+#define TABLES_REPLACE 8                    // one in this many entries is replaced by a new record every round
+
+typedef struct table_record
+{
+    size_t key; // index of the entry referencing the record
+    char pad[24];
+} table_record;
+
+static const uint64_t g_table_bitmap[] = {1};                                // every word of the table is a reference
+static const gclib_layout g_table_layout = {sizeof(void *), g_table_bitmap}; // layout repeated for every entry
+static table_record **g_table;                                               // the table, reachable through the data segment
+
+static size_t run(bench_variant variant, bool compaction);
+static size_t check(void);
+
+void bench_tables(void)
+{
+    size_t ops;
+    bench_variant variant;
+    bench_run run_info;
+
+    // A table big enough to be mapped on its own whose entries are only ever referenced through the words its layout
+    // describes, so compaction is free to move them (and has to rewrite the table for every one it does)
+    for (variant = BENCH_GCLIB; variant <= BENCH_GCLIB_SLAB; variant++)
+    {
+        bench_begin(&run_info, "tables", variant, "entries=%d,compaction=0", TABLES_ENTRIES);
+        ops = run(variant, false);
+        bench_end(&run_info, ops);
+        bench_begin(&run_info, "tables", variant, "entries=%d,compaction=1", TABLES_ENTRIES);
+        ops = run(variant, true);
+        bench_end(&run_info, ops);
+    }
+
+    return;
+}
+
+/* Fill the table with records, then replace some of them and collect the whole heap over a number of rounds, checking every record after each. Return the number of records allocated. */
+static size_t run(bench_variant variant, bool compaction)
+{
+    size_t round, i, entries, ops = 0;
+
+    gclib_set_compaction(compaction);
+    entries = TABLES_FILLED * g_bench_scale;
+    g_table = gclib_alloc_typed(TABLES_ENTRIES * sizeof(table_record *), true, &g_table_layout);
+    for (round = 0; round < TABLES_ROUNDS; round++)
+    {
+        for (i = round % TABLES_REPLACE; i < entries; i += (round == 0) ? 1 : TABLES_REPLACE)
+        {
+            bench_write_ptr(variant, &g_table[i], bench_alloc(variant, sizeof(table_record), false));
+            g_table[i]->key = i;
+            ops++;
+        }
+
+        gclib_force_collect();
+        if (check() != entries)
+        {
+            abort();
+        }
+    }
+
+    g_table = NULL;
+    gclib_set_compaction(false);
+
+    return ops;
+}
+
+/* Return the number of entries at the start of the table that refer to their own record. */
+static size_t check(void)
+{
+    size_t i;
+
+    for (i = 0; i < TABLES_ENTRIES && g_table[i] != NULL && g_table[i]->key == i; i++)
+        ;
+
+    return i;
+}
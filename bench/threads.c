@@ -0,0 +1,209 @@
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define THREADS_SLOTS 64      // number of lists each thread keeps live at a time
+#define THREADS_LIST_LEN 64   // number of nodes per list
+#define THREADS_BUILT 10000   // number of lists each thread builds per run
+#define THREADS_KEPT_LEN 1024 // number of nodes in the long-lived list of each thread
+#define THREADS_MAX 8         // largest number of threads a run uses
+#define THREADS_PAYLOAD (-2)  // value of every payload node, which no list node holds
+
+typedef struct thread_node
+{
+    struct thread_node *p_next;
+    struct thread_node *p_payload; // on the long-lived list, a node allocated much later
+    long value;
+} thread_node;
+
+/* What each thread of a run is given to work with. */
+typedef struct thread_work
+{
+    pthread_t thread;
+    bench_variant variant;
+    size_t built;
+    bool failed;
+} thread_work;
+
+static const size_t g_thread_counts[] = {2, 4, THREADS_MAX};
+
+static void *thread_main(void *p_arg);
+static thread_node *build(bench_variant variant, size_t len, long value);
+static bool check(const thread_node *p_list, size_t len, long value);
+static void destroy(bench_variant variant, thread_node *p_list);
+
+void bench_threads(void)
+{
+    size_t i, t, count, ops;
+    bool failed;
+    bench_variant variant;
+    bench_run run_info;
+    thread_work work[THREADS_MAX];
+
+    // Every thread builds and checks lists of its own, rooted only in its stack, while it keeps replacing the payloads of
+    // a long-lived list so that older chunks keep getting references to younger ones through `gclib_write_ptr()`
+    for (i = 0; i < sizeof(g_thread_counts) / sizeof(g_thread_counts[0]); i++)
+    {
+        count = g_thread_counts[i];
+        for (variant = BENCH_MALLOC; variant < BENCH_VARIANTS; variant++)
+        {
+            if (variant == BENCH_GCLIB) // without slab pages, every allocation takes the same lock
+            {
+                continue;
+            }
+
+            bench_begin(&run_info, "threads", variant, "threads=%zu,list_len=%d", count, THREADS_LIST_LEN);
+            for (t = 0; t < count; t++)
+            {
+                work[t].variant = variant;
+                if (pthread_create(&work[t].thread, NULL, thread_main, &work[t]) != 0)
+                {
+                    abort();
+                }
+            }
+
+            ops = 0;
+            failed = false;
+            for (t = 0; t < count; t++)
+            {
+                pthread_join(work[t].thread, NULL);
+                ops += work[t].built * THREADS_LIST_LEN;
+                failed = failed || work[t].failed;
+            }
+
+            bench_end(&run_info, ops);
+            if (failed)
+            {
+                abort();
+            }
+        }
+    }
+
+    return;
+}
+
+/* Build and check lists until `THREADS_BUILT` of them have been built, reporting through the `thread_work` at `p_arg`. */
+static void *thread_main(void *p_arg)
+{
+    size_t i, slot;
+    thread_node *p_kept, *p_node, *slots[THREADS_SLOTS] = {NULL};
+    thread_work *p_work = p_arg;
+
+    if (p_work->variant != BENCH_MALLOC && !gclib_register_thread())
+    {
+        abort();
+    }
+
+    p_work->failed = false;
+    p_kept = build(p_work->variant, THREADS_KEPT_LEN, -1);
+    p_node = p_kept;
+    for (i = 0; i < THREADS_BUILT * g_bench_scale; i++)
+    {
+        slot = (i * 7919) % THREADS_SLOTS;
+        if (slots[slot] != NULL)
+        {
+            p_work->failed = p_work->failed || !check(slots[slot], THREADS_LIST_LEN, slots[slot]->value);
+            if (p_work->variant == BENCH_MALLOC)
+            {
+                destroy(p_work->variant, slots[slot]);
+            }
+        }
+
+        slots[slot] = build(p_work->variant, THREADS_LIST_LEN, (long) i);
+
+        // Replace a payload of the long-lived list, which may have been promoted long ago, with a new node
+        if (p_work->variant == BENCH_MALLOC && p_node->p_payload != NULL)
+        {
+            bench_free(p_work->variant, p_node->p_payload);
+        }
+
+        bench_write_ptr(p_work->variant, &p_node->p_payload, bench_alloc(p_work->variant, sizeof(thread_node), true));
+        p_node->p_payload->value = THREADS_PAYLOAD;
+        p_node = (p_node->p_next != NULL) ? p_node->p_next : p_kept;
+    }
+
+    // Every payload has to have survived along with the lists
+    p_work->failed = p_work->failed || !check(p_kept, THREADS_KEPT_LEN, -1);
+    for (p_node = p_kept; p_node != NULL; p_node = p_node->p_next)
+    {
+        p_work->failed = p_work->failed || (p_node->p_payload != NULL && p_node->p_payload->value != THREADS_PAYLOAD);
+    }
+
+    for (slot = 0; p_work->variant == BENCH_MALLOC && slot < THREADS_SLOTS; slot++)
+    {
+        if (slots[slot] != NULL)
+        {
+            destroy(p_work->variant, slots[slot]);
+        }
+    }
+
+    for (p_node = p_kept; p_work->variant == BENCH_MALLOC && p_node != NULL; p_node = p_node->p_next)
+    {
+        bench_free(p_work->variant, p_node->p_payload);
+    }
+
+    if (p_work->variant == BENCH_MALLOC)
+    {
+        destroy(p_work->variant, p_kept);
+    }
+    else
+    {
+        gclib_unregister_thread();
+    }
+
+    p_work->built = i;
+
+    return NULL;
+}
+
+/* Build a list of `len` nodes holding `value`, and return its first node. */
+static thread_node *build(bench_variant variant, size_t len, long value)
+{
+    size_t i;
+    thread_node *p_list, *p_node;
+
+    p_list = NULL;
+    for (i = 0; i < len; i++)
+    {
+        p_node = bench_alloc(variant, sizeof(thread_node), false);
+        p_node->p_payload = NULL;
+        p_node->value = value;
+        bench_write_ptr(variant, &p_node->p_next, p_list);
+        p_list = p_node;
+    }
+
+    return p_list;
+}
+
+/* Return whether the list starting at `p_list` has `len` nodes that all hold `value`. */
+static bool check(const thread_node *p_list, size_t len, long value)
+{
+    size_t i;
+    const thread_node *p_node;
+
+    for (i = 0, p_node = p_list; p_node != NULL; i++, p_node = p_node->p_next)
+    {
+        if (p_node->value != value)
+        {
+            return false;
+        }
+    }
+
+    return i == len;
+}
+
+/* Free every node of a list. */
+static void destroy(bench_variant variant, thread_node *p_list)
+{
+    thread_node *p_next;
+
+    while (p_list != NULL)
+    {
+        p_next = p_list->p_next;
+        bench_free(variant, p_list);
+        p_list = p_next;
+    }
+
+    return;
+}
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define TREES_MIN_DEPTH 4
+#define TREES_MAX_DEPTH 13 // depth of the long-lived tree; short-lived trees go from `TREES_MIN_DEPTH` up to it
+
+typedef struct tree_node
+{
+    struct tree_node *p_left;
+    struct tree_node *p_right;
+} tree_node;
+
+static tree_node *build(bench_variant variant, unsigned int depth, size_t *p_nodes);
+static size_t check(const tree_node *p_node);
+static void destroy(bench_variant variant, tree_node *p_node);
+
+void bench_trees(void)
+{
+    unsigned int depth, max_depth;
+    size_t i, iterations, nodes, checked;
+    tree_node *p_long_lived, *p_tree;
+    bench_variant variant;
+    bench_run run_info;
+
+    // The classic binary-trees workload: a long-lived tree stays around while ever more (but ever shallower) trees are
+    // built, walked and dropped
+    max_depth = TREES_MAX_DEPTH + (g_bench_scale > 1 ? 3 : 0); // every level doubles the work
+    for (variant = BENCH_MALLOC; variant < BENCH_VARIANTS; variant++)
+    {
+        bench_begin(&run_info, "trees", variant, "max_depth=%u", max_depth);
+        nodes = checked = 0;
+        p_long_lived = build(variant, max_depth, &nodes);
+        for (depth = TREES_MIN_DEPTH; depth <= max_depth; depth += 2)
+        {
+            iterations = (size_t) 1 << (max_depth - depth + TREES_MIN_DEPTH);
+            for (i = 0; i < iterations; i++)
+            {
+                p_tree = build(variant, depth, &nodes);
+                checked += check(p_tree);
+                if (variant == BENCH_MALLOC)
+                {
+                    destroy(variant, p_tree);
+                }
+            }
+        }
+
+        checked += check(p_long_lived);
+        if (variant == BENCH_MALLOC)
+        {
+            destroy(variant, p_long_lived);
+        }
+
+        bench_end(&run_info, nodes);
+        if (checked != nodes)
+        {
+            abort();
+        }
+    }
+
+    return;
+}
+
+/* Build a complete binary tree of the given depth, adding the number of nodes allocated to `*p_nodes`. */
+static tree_node *build(bench_variant variant, unsigned int depth, size_t *p_nodes)
+{
+    tree_node *p_node;
+
+    p_node = bench_alloc(variant, sizeof(tree_node), false);
+    (*p_nodes)++;
+    if (depth == 0)
+    {
+        p_node->p_left = p_node->p_right = NULL;
+    }
+    else
+    {
+        // Children are younger than their parent, which a collection in between may already have promoted
+        bench_write_ptr(variant, &p_node->p_left, build(variant, depth - 1, p_nodes));
+        bench_write_ptr(variant, &p_node->p_right, build(variant, depth - 1, p_nodes));
+    }
+
+    return p_node;
+}
+
+/* Return the number of nodes in the tree rooted at `p_node`. */
+static size_t check(const tree_node *p_node)
+{
+    if (p_node->p_left == NULL)
+    {
+        return 1;
+    }
+
+    return 1 + check(p_node->p_left) + check(p_node->p_right);
+}
+
+/* Free every node of the tree rooted at `p_node`. */
+static void destroy(bench_variant variant, tree_node *p_node)
+{
+    if (p_node->p_left != NULL)
+    {
+        destroy(variant, p_node->p_left);
+        destroy(variant, p_node->p_right);
+    }
+
+    bench_free(variant, p_node);
+
+    return;
+}
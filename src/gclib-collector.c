@@ -1,65 +1,380 @@
+#define _GNU_SOURCE // for `mremap()`
+
+#include <immintrin.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "gclib-collector.h"
+#include "gclib-compact.h"
+#include "gclib-dirty.h"
+#include "gclib-marker.h"
+#include "gclib-memory.h"
+#include "gclib-mutator.h"
+#include "gclib-region.h"
+#include "gclib-site.h"
+#include "gclib-stats.h"
+#include "gclib-weak.h"
 
-const void **g_stack_start_ptr; // Address of the stack frame after the last user-called function (the stack is iterated through in a top-down manner)
-const void **g_stack_end_ptr;   // Address of the stack frame of `main()` (the stack is iterated through in a top-down manner)
 const void **g_data_start_ptr;  // Address of the start of the initialized data segment
 const void **g_data_end_ptr;    // Address of the end of the BSS segment
+size_t g_alloc_debt;            // Number of bytes allocated since the last collection
+size_t g_collect_trigger;       // Value of `g_alloc_debt` at which the next collection runs
+bool g_mark_stack_overflow;     // Set when a chunk was marked but couldn't be pushed because a mark stack couldn't grow
+bool g_mark_parallel;           // Whether several markers are running at once
+bool g_sweep_pending;           // Whether the last collection still has chunks left to sweep
+bool g_scan_data = true;        // Whether the data and BSS segments are scanned as roots (on top of the registered root ranges)
+bool g_mark_active;             // Whether an incremental or concurrent collection has started marking but hasn't finished yet
+unsigned int g_pause_target;    // Microseconds of marking each allocation may do during an incremental collection, or 0 to mark all at once
+bool g_concurrent;              // Whether collections mark on the background thread while the program keeps running
+size_t g_heap_limit;            // Number of bytes the resident set size of the process should stay below, or 0 for no limit
 
-void collector_run(bool all_gens)
-{
-    g_stack_start_ptr = (const void **) __builtin_frame_address(1); // address of stack frame of caller of `collecter_run()` (should be a `gclib` function called by the user); https://gcc.gnu.org/onlinedocs/gcc/Return-Address.html#index-_005f_005fbuiltin_005fframe_005faddress
+static size_t g_gen_budget[GENERATIONS];     // minimum number of bytes each generation may take up (or for generation 0, be allocated) before it is collected
+static size_t g_gen_trigger[GENERATIONS];    // number of bytes each older generation may take up before it is collected (unused for generation 0)
+static size_t g_gen_live_bytes[GENERATIONS]; // number of bytes left in each generation after it was last collected
+static size_t g_live_bytes;                  // number of bytes left in the whole heap after the last collection
+static unsigned int g_growth_percent;        // how far the heap may grow past `g_live_bytes` before it is collected again
+static bool g_limit_reached;                 // whether the resident set size was close to `g_heap_limit` after the last collection
+static size_t g_released_bytes;              // number of bytes collections had freed when memory was last given back to the system
+static uint8_t g_tenure_age;                 // number of collections of its generation a chunk has to survive before it is promoted
+static uint8_t g_next_generations;           // value of `g_generations` from the start of the next collection on
+static uint8_t g_next_tenure_age;            // value of `g_tenure_age` from the start of the next collection on
+
+static root_range *g_roots;  // root ranges registered through `collector_add_root()`
+static size_t g_roots_len;   // number of ranges in `g_roots`
+static size_t g_roots_cap;   // number of ranges `g_roots` has room for
+
+static bool g_mark_gens[GENERATIONS];                            // generations being collected by the current (or last) collection
+static size_t g_remset_next;                                     // position in `g_remset` of the next card to scan as roots
+static size_t g_remset_scan_cap;                                 // value of `g_remset_cap` when the scan of the remembered set (re)started
+static bool g_remset_pending;                                    // whether the remembered set still has to be scanned for the current collection
+static bool g_mark_slabs;                                        // whether slab objects take part in the current collection (they are swept along with generation 0)
+static bool g_mark_compact;                                      // whether the current collection evacuates the oldest generation once it is done marking
+static mark_stack g_mark_stack;                                  // worklist of roots and reachable chunks whose contents have yet to be scanned
+static pthread_mutex_t g_remset_lock = PTHREAD_MUTEX_INITIALIZER; // serializes additions to the remembered set while marking in parallel
+
+static bool g_mark_concurrent;      // whether the current collection marks on the background thread
+static void **g_remark_chunks;      // chunks allocated (or moved) by the program since the current concurrent collection started
+static size_t g_remark_chunks_len;  // number of chunks in `g_remark_chunks`
+static size_t g_remark_chunks_cap;  // number of chunks `g_remark_chunks` has room for
+static bool g_remark_overflow;      // set when a chunk couldn't be added to `g_remark_chunks`
+static void **g_pretenured;         // chunks allocated straight into an older generation that collections still have to scan
+static size_t g_pretenured_len;     // number of chunks in `g_pretenured`
+static size_t g_pretenured_cap;     // number of chunks `g_pretenured` has room for
+static const void **g_remember_buffer;   // words the background thread found to need remembering, which only the final pause adds to the remembered set
+static size_t g_remember_buffer_len;     // number of words in `g_remember_buffer`
+static size_t g_remember_buffer_cap;     // number of words `g_remember_buffer` has room for
+
+static bool g_sweep_gens[GENERATIONS]; // generations collected by the pending sweep
+static size_t g_sweep_next;            // position in `g_chunk_index` of the next chunk to sweep
+
+static uint64_t g_cycle_start_ns; // time at which the current (or last) collection started
+static uint8_t g_cycle_oldest;    // oldest generation collected by the current (or last) collection
+static uint8_t g_sweep_oldest;    // oldest generation collected by the pending sweep
 
-    bool to_collect[GENERATIONS];
+static uint64_t (*g_scan_filter)(const void **block, size_t words, uintptr_t low, uintptr_t span); // `filter_avx2()` where the processor supports it, `filter_scalar()` otherwise
+
+static void roots_push(void);
+static void data_push(bool dirty_only);
+static size_t dirty_push(const void **start, const void **end, uint8_t gen);
+static void remark_push(void);
+static void pretenured_push(void);
+static void mark_finish(void);
+static uint8_t promoted_gen(uint8_t gen);
+static uint8_t surviving_gen(const chunk_node *p_node);
+static void generations_apply(void);
+static void remember(const void *ptr);
+static void remset_scan(size_t cards);
+static void pacing_update(bool to_collect[GENERATIONS]);
+static void release_freed(void);
+static void sweep_chunk(chunk_node *p_node);
+static void sweep_large(void);
+static void scan_ambiguous(mark_stack *p_stack, const void **start, const void **end, uint8_t gen);
+static uint64_t filter_scalar(const void **block, size_t words, uintptr_t low, uintptr_t span);
+static uint64_t filter_avx2(const void **block, size_t words, uintptr_t low, uintptr_t span);
+static void scan_word(mark_stack *p_stack, const void **ptr, chunk_node *p_current, uint8_t gen, bool ambiguous);
+
+void collector_init(void)
+{
     uint8_t gen;
 
-    // See which generations need to be collected
     for (gen = 0; gen < GENERATIONS; gen++)
     {
-        if (all_gens || g_alloced_bytes[gen] > MAX_ALLOCED_BYTES)
+        g_gen_budget[gen] = g_gen_trigger[gen] = DEFAULT_GEN_BUDGET;
+        g_gen_live_bytes[gen] = 0;
+    }
+
+    g_growth_percent = DEFAULT_GROWTH_PERCENT;
+    g_live_bytes = g_alloc_debt = 0;
+    g_generations = g_next_generations = g_stats.generations = DEFAULT_GENERATIONS;
+    g_tenure_age = g_next_tenure_age = DEFAULT_TENURE_AGE;
+    g_collect_trigger = DEFAULT_GEN_BUDGET;
+
+    // In a container, stay clear of the limit it would be killed at
+    g_heap_limit = memory_cgroup_limit() / 100 * MEMORY_CGROUP_PERCENT;
+    g_limit_reached = false;
+    g_released_bytes = 0;
+    pacing_update((bool [GENERATIONS]) { false });
+
+    g_scan_filter = __builtin_cpu_supports("avx2") ? filter_avx2 : filter_scalar;
+
+    return;
+}
+
+void collector_run(bool all_gens)
+{
+    bool due;
+    uint8_t gen;
+
+    if (!g_mark_active && !all_gens && g_alloc_debt < g_collect_trigger) // generation 0 isn't due and older generations only grow during collections
+    {
+        return;
+    }
+
+    stats_pause_begin();
+
+    if (g_mark_active) // an incremental or concurrent collection is under way, which has to be finished before another one can start
+    {
+        mark_finish();
+
+        if (!all_gens)
         {
-            to_collect[gen] = true;
+            stats_pause_end();
+
+            return;
         }
-        else
+    }
+
+    collector_sweep_finish(); // the chunks the last collection found unreachable have to be gone before the index is rebuilt
+    generations_apply();
+
+    // See which generations need to be collected. Collecting a generation also means collecting every younger one
+    // since references from younger chunks to older ones are only found by tracing through the younger chunks.
+    for (gen = g_generations; gen < GENERATIONS; gen++)
+    {
+        g_mark_gens[gen] = false;
+    }
+
+    // Close to the heap limit, there is no telling which generations the garbage is in. Once a word couldn't be
+    // remembered, only tracing every generation finds the young chunks that are referenced through it.
+    due = all_gens || g_limit_reached || g_remset_overflow;
+    for (gen = g_generations - 1; gen > 0; gen--)
+    {
+        due = due || g_alloced_bytes[gen] > g_gen_trigger[gen];
+        g_mark_gens[gen] = due;
+    }
+    g_mark_gens[0] = true;
+
+    if (!table_build_index(g_mark_gens)) // not enough memory to find the chunks being collected
+    {
+        stats_pause_end();
+
+        return;
+    }
+
+    g_cycle_oldest = 0;
+    for (gen = 0; gen < g_generations && g_mark_gens[gen]; gen++)
+    {
+        g_stats.gens[gen].collections++;
+        g_cycle_oldest = gen;
+    }
+
+    stats_cycle_event(GCLIB_CYCLE_START);
+    g_cycle_start_ns = stats_now_ns();
+
+    g_mark_slabs = g_mark_gens[0];
+    g_alloc_debt = 0;
+    pretenured_push();
+
+    // Chunks are only moved when every reference to them can be found, which takes tracing the whole heap while the
+    // program can't allocate anything new or store a reference anywhere
+    g_mark_compact = g_compact_enabled && g_mark_gens[g_generations - 1] && (all_gens || (!g_concurrent && g_pause_target == 0));
+
+    // Older generations that aren't collected aren't traced either, so the words in them that were remembered as
+    // possibly referencing younger chunks become additional roots, which are scanned along with the mark stack. Full
+    // collections trace everything and rebuild the remembered set from scratch while doing so.
+    if (g_mark_gens[g_generations - 1])
+    {
+        remset_clear();
+        g_remset_pending = false;
+    }
+    else
+    {
+        g_remset_next = 0;
+        g_remset_scan_cap = g_remset_cap;
+        g_remset_pending = true;
+    }
+
+    // Concurrent collections mark on the background thread from what the heap looked like when they started. Every
+    // page the program writes to from then on is flagged by the kernel, and the final pause rescans the marked chunks
+    // on those pages along with the stacks and the chunks allocated in the meantime.
+    if (g_concurrent && !all_gens)
+    {
+        dirty_clear();
+        data_push(false);
+        g_mark_active = g_mark_concurrent = true;
+        marker_background_run(&g_mark_stack);
+        stats_pause_end();
+
+        return;
+    }
+
+    // Incremental collections mark a bit at a time during later allocations, relying on `gclib_write_ptr()` to shade
+    // every reference that is stored into a chunk in the meantime. Stacks, registers, and global variables are
+    // written to without it, so they are scanned once more by the final pause.
+    if (g_pause_target > 0 && !all_gens)
+    {
+        data_push(false);
+        g_mark_active = true;
+        collector_mark_step();
+        stats_pause_end();
+
+        return;
+    }
+
+    mark_finish();
+
+    // Dead chunks are freed by later allocations instead of during the pause, unless the caller wants the memory back now
+    if (all_gens)
+    {
+        collector_sweep_finish();
+    }
+
+    stats_pause_end();
+
+    return;
+}
+
+bool collector_add_root(const void **start, const void **end)
+{
+    size_t new_cap;
+    root_range *p_new_roots;
+
+    if (g_roots_len == g_roots_cap)
+    {
+        new_cap = (g_roots_cap == 0) ? ROOTS_INITIAL_SIZE : 2 * g_roots_cap;
+        p_new_roots = realloc(g_roots, new_cap * sizeof(root_range));
+        if (p_new_roots == NULL)
+        {
+            return false;
+        }
+
+        g_roots = p_new_roots;
+        g_roots_cap = new_cap;
+    }
+
+    g_roots[g_roots_len].start = start;
+    g_roots[g_roots_len].end = end;
+    g_roots_len++;
+
+    return true;
+}
+
+void collector_remove_root(const void **start)
+{
+    size_t i;
+
+    for (i = g_roots_len; i-- > 0;) // the latest range first, so that one registered for a moment leaves the others alone
+    {
+        if (g_roots[i].start == start)
         {
-            to_collect[gen] = false;
+            g_roots[i] = g_roots[--g_roots_len]; // the order roots are scanned in doesn't matter
+
+            return;
         }
     }
 
-    collector_mark(to_collect, g_stack_start_ptr, g_stack_end_ptr);
-    collector_mark(to_collect, g_data_start_ptr, g_data_end_ptr);
-    collector_sweep(to_collect);
+    return;
+}
+
+void collector_set_budget(uint8_t gen, size_t bytes)
+{
+    g_gen_budget[gen] = bytes;
+    pacing_update((bool [GENERATIONS]) { false }); // recompute the triggers without pretending anything was collected
 
     return;
 }
 
-void collector_mark(bool to_collect[GENERATIONS], const void **start, const void **end)
+void collector_set_growth(unsigned int percent)
 {
-    const void **ptr;
-    uint16_t idx;
-    uint8_t gen;
-    chunk_node *p_current;
+    g_growth_percent = percent;
+    pacing_update((bool [GENERATIONS]) { false });
+
+    return;
+}
+
+void collector_set_limit(size_t bytes)
+{
+    g_heap_limit = bytes;
+    pacing_update((bool [GENERATIONS]) { false });
+
+    return;
+}
+
+void collector_set_generations(uint8_t count)
+{
+    g_next_generations = count; // chunks can only change generations between collections
+
+    return;
+}
+
+void collector_set_tenure_age(uint8_t collections)
+{
+    g_next_tenure_age = collections; // the collection under way chose which references to remember by which chunks it is going to promote
+
+    return;
+}
+
+void collector_mark(void)
+{
+    size_t i, object;
+    chunk_node *p_node;
+    slab_page *p_page;
 
-    // Treat each block of 8-bytes as a pointer (that could potentially point to a user-allocated chunk)
-    for (ptr = start; ptr < end; ptr++)
+    if (g_marker_threads > 1)
     {
-        idx = table_hash_ptr(*ptr);
-        for (gen = 0; gen < GENERATIONS; gen++)
+        marker_run(&g_mark_stack);
+    }
+    else
+    {
+        collector_drain(&g_mark_stack);
+    }
+
+    // Chunks that were marked but never pushed still have to be scanned. Rather than keeping track of which ones they
+    // were, rescan every marked chunk (which is harmless for those that were already scanned) until nothing is dropped.
+    while (g_mark_stack_overflow)
+    {
+        g_mark_stack_overflow = false;
+
+        for (i = 0; i < g_chunk_index_len; i++)
         {
-            if (to_collect[gen])
+            p_node = g_chunk_index[i];
+            if (p_node->reachable)
+            {
+                collector_scan(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+                collector_drain(&g_mark_stack);
+            }
+        }
+
+        for (i = 0; i < g_large_index_len; i++)
+        {
+            p_node = g_large_index[i];
+            if (p_node->reachable)
+            {
+                collector_scan(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, MARK_UNTRACKED, p_node->p_layout);
+                collector_drain(&g_mark_stack);
+            }
+        }
+
+        for (i = 0; g_mark_slabs && i < g_slab_page_count; i++)
+        {
+            p_page = g_slab_pages[i];
+            for (object = 0; !p_page->atomic && object < p_page->objects; object++)
             {
-                // Iterate through linked list and mark reachable chunks
-                for (p_current = g_hash_table[gen][idx]; p_current != NULL; p_current = p_current->next)
+                if (p_page->mark_bits[object / 64] & (UINT64_C(1) << (object % 64)))
                 {
-                    // Incrementing `p_current->ptr` (which is `void *`) below only works because with GCC, `sizeof(void)` is 1
-                    // Casting to `char *` and then `void *` is technically more correct (and portable) but makes the code harder to understand
-                    if (p_current->ptr <= *ptr && *ptr < p_current->ptr + p_current->size) // `ptr` is the address of a reference to `p_current`
-                    {
-                        p_current->reachable = true;
-
-                        // same issue with incrementing a `void *` as above
-                        collector_mark(to_collect, p_current->ptr, p_current->ptr + p_current->size); // since this chunk is reachable, any chunk it references is also reachable
-                    }
+                    collector_scan(&g_mark_stack, p_page->base + object * slab_object_size(p_page), p_page->base + (object + 1) * slab_object_size(p_page), MARK_UNTRACKED, NULL);
+                    collector_drain(&g_mark_stack);
                 }
             }
         }
@@ -68,65 +383,1252 @@ void collector_mark(bool to_collect[GENERATIONS], const void **start, const void
     return;
 }
 
-void collector_sweep(bool to_collect[GENERATIONS])
+bool collector_push(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout)
 {
-    uint16_t idx;
-    uint8_t gen;
-    chunk_node *p_current, *p_previous;
+    size_t new_cap;
+    mark_range *p_new_ranges;
 
-    for (gen = GENERATIONS - 1; 0 <= gen && gen < GENERATIONS; gen--) // generations MUST be collected in reverse order to avoid any issues with promotions to higher generations
+    // Root ranges such as the one starting at `&etext` aren't necessarily aligned, which would make every read straddle two words
+    start = (const void **) (((uintptr_t) start + sizeof(void *) - 1) & ~(uintptr_t) (sizeof(void *) - 1));
+
+    // Stacks grow while the other threads are stopped, when one of them may be holding a lock inside `malloc()`, so
+    // they are mapped on their own instead
+    if (p_stack->len == p_stack->cap)
     {
-        if (to_collect[gen])
+        new_cap = (p_stack->cap == 0) ? MARK_STACK_INITIAL_SIZE : 2 * p_stack->cap;
+        if (p_stack->cap == 0)
+        {
+            p_new_ranges = mmap(NULL, new_cap * sizeof(mark_range), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        else
+        {
+            p_new_ranges = mremap(p_stack->p_ranges, p_stack->cap * sizeof(mark_range), new_cap * sizeof(mark_range), MREMAP_MAYMOVE);
+        }
+
+        if (p_new_ranges == MAP_FAILED) // `collector_mark()` finds a dropped chunk again by rescanning every marked chunk, but the caller has to deal with anything else
+        {
+            __atomic_store_n(&g_mark_stack_overflow, true, __ATOMIC_RELAXED);
+
+            return false;
+        }
+
+        p_stack->p_ranges = p_new_ranges;
+        p_stack->cap = new_cap;
+    }
+
+    p_stack->p_ranges[p_stack->len].start = start;
+    p_stack->p_ranges[p_stack->len].end = end;
+    p_stack->p_ranges[p_stack->len].gen = gen;
+    p_stack->p_ranges[p_stack->len].p_layout = p_layout;
+    p_stack->len++;
+
+    return true;
+}
+
+void collector_push_root(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout)
+{
+    // Rescanning the marked chunks wouldn't find a dropped root again, so it is scanned right away instead, which only
+    // pushes the contents of the chunks it marks
+    if (!collector_push(p_stack, start, end, gen, p_layout))
+    {
+        collector_scan(p_stack, start, end, gen, p_layout);
+    }
+
+    return;
+}
+
+void collector_scan(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout)
+{
+    const void **ptr, **element;
+    size_t words, bitmap_word;
+    uint64_t bits;
+
+    if (p_layout == NULL) // treat each block of 8-bytes as a pointer (that could potentially point to a user-allocated chunk)
+    {
+        scan_ambiguous(p_stack, start, end, gen);
+
+        return;
+    }
+
+    if (p_layout->p_bitmap == NULL) // atomic chunks are never pushed, but nothing in them would need scanning anyway
+    {
+        return;
+    }
+
+    // Only visit the words that the layout says may hold a reference, one element of the array at a time
+    words = p_layout->size / sizeof(void *);
+    for (element = start; element < end; element += words)
+    {
+        for (bitmap_word = 0; bitmap_word < (words + 63) / 64; bitmap_word++)
         {
-            for (idx = 0; idx < HASH_TABLE_SIZE; idx++)
+            for (bits = p_layout->p_bitmap[bitmap_word]; bits != 0; bits &= bits - 1)
             {
-                p_previous = NULL;
-                p_current = g_hash_table[gen][idx];
-                while (p_current != NULL)
+                ptr = element + bitmap_word * 64 + __builtin_ctzll(bits);
+                if (ptr >= end) // the chunk ends in the middle of an element
                 {
-                    if (p_current->reachable) // promote to next generation
-                    {
-                        p_current->reachable = false; // set up for next mark-cycle
-
-                        if (gen < GENERATIONS - 1)
-                        {
-                            list_unlink(gen, idx, p_current, p_previous);
-                            list_link(gen + 1, idx, p_current);
-
-                            if (p_previous == NULL) // unlinked the head of the list
-                            {
-                                p_current = g_hash_table[gen][idx];
-                            }
-                            else
-                            {
-                                p_current = p_previous->next;
-                            }
-                        }
-                        else // already in highest generation so can't promote
-                        {
-                            p_previous = p_current;
-                            p_current = p_current->next;
-                        }
-                    }
-                    else // unreachable chunk; free it
-                    {
-                        list_unlink(gen, idx, p_current, p_previous);
-                        free(p_current->ptr);
-                        free(p_current);
-
-                        if (p_previous == NULL) // freed the head of the list
-                        {
-                            p_current = g_hash_table[gen][idx];
-                        }
-                        else
-                        {
-                            p_current = p_previous->next;
-                        }
-                    }
+                    return;
                 }
+
+                scan_word(p_stack, ptr, table_find_chunk(*ptr), gen, false);
             }
         }
     }
 
     return;
 }
+
+size_t collector_slice_words(const gclib_layout *p_layout)
+{
+    size_t words;
+
+    if (p_layout == NULL)
+    {
+        return MARK_SLICE_WORDS;
+    }
+
+    words = p_layout->size / sizeof(void *);
+
+    return (words >= MARK_SLICE_WORDS) ? words : MARK_SLICE_WORDS - MARK_SLICE_WORDS % words;
+}
+
+void collector_mark_step(void)
+{
+    uint64_t deadline;
+
+    if (g_mark_concurrent) // the background thread does the marking, so there is nothing to do but wait for it
+    {
+        if (!__atomic_load_n(&g_mark_background, __ATOMIC_ACQUIRE))
+        {
+            stats_pause_begin();
+            mark_finish();
+            stats_pause_end();
+        }
+
+        return;
+    }
+
+    stats_pause_begin();
+
+    if (g_pause_target == 0) // incremental collection was turned off halfway through
+    {
+        mark_finish();
+        stats_pause_end();
+
+        return;
+    }
+
+    deadline = stats_now_ns() + (uint64_t) g_pause_target * 1000;
+    while (g_remset_pending || g_mark_stack.len > 0)
+    {
+        if (g_remset_pending)
+        {
+            remset_scan(REMSET_SCAN_CARDS);
+        }
+        else
+        {
+            collector_scan_next(&g_mark_stack);
+        }
+
+        if (stats_now_ns() >= deadline)
+        {
+            stats_pause_end();
+
+            return;
+        }
+    }
+
+    mark_finish(); // only what the program wrote without going through `gclib_write_ptr()` is left
+    stats_pause_end();
+
+    return;
+}
+
+void collector_shade(const void **start, const void **end, const gclib_layout *p_layout)
+{
+    if (g_mark_active && !g_mark_concurrent) // the mark stack belongs to the background thread, which doesn't need shading anyway
+    {
+        collector_scan(&g_mark_stack, start, end, MARK_UNTRACKED, p_layout);
+    }
+
+    return;
+}
+
+void collector_merge_barriers(void)
+{
+    size_t len;
+    const void **ptr;
+    mutator *p_mutator;
+    remset_buffer *p_buffer;
+
+    for (p_mutator = g_mutators; p_mutator != NULL; p_mutator = p_mutator->next)
+    {
+        // The thread may be adding to its buffer at the same time, but only past `len`, and it only empties the buffer
+        // while holding `g_gclib_lock`
+        p_buffer = &p_mutator->barrier;
+        len = __atomic_load_n(&p_buffer->len, __ATOMIC_ACQUIRE);
+        for (; p_buffer->merged < len; p_buffer->merged++)
+        {
+            ptr = (const void **) p_buffer->words[p_buffer->merged];
+            remset_add(ptr);
+            collector_shade(ptr, ptr + 1, NULL); // the reference may have been stored after the chunk containing it was scanned
+        }
+    }
+
+    return;
+}
+
+void collector_merge_remembered(void)
+{
+    size_t i;
+
+    // While the background thread is still marking, it adds to the buffer without holding any lock. It only remembers
+    // words within the chunks it scans, so whatever it hasn't finished with yet can't lie in memory outside of them.
+    if (!g_mark_concurrent || __atomic_load_n(&g_mark_background, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    for (i = 0; i < g_remember_buffer_len; i++)
+    {
+        remset_add(g_remember_buffer[i]);
+    }
+    g_remember_buffer_len = 0;
+
+    return;
+}
+
+void collector_note_alloc(void *ptr)
+{
+    size_t new_cap;
+    void **p_new_chunks;
+
+    if (!g_mark_concurrent)
+    {
+        return;
+    }
+
+    if (g_remark_chunks_len == g_remark_chunks_cap)
+    {
+        new_cap = (g_remark_chunks_cap == 0) ? MARK_STACK_INITIAL_SIZE : 2 * g_remark_chunks_cap;
+        p_new_chunks = realloc(g_remark_chunks, new_cap * sizeof(void *));
+        if (p_new_chunks == NULL) // the final pause will look through the whole chunk table instead
+        {
+            g_remark_overflow = true;
+
+            return;
+        }
+
+        g_remark_chunks = p_new_chunks;
+        g_remark_chunks_cap = new_cap;
+    }
+
+    g_remark_chunks[g_remark_chunks_len++] = ptr;
+
+    return;
+}
+
+bool collector_note_pretenured(void *ptr)
+{
+    size_t new_cap;
+    void **p_new_chunks;
+
+    if (g_pretenured_len == g_pretenured_cap)
+    {
+        new_cap = (g_pretenured_cap == 0) ? MARK_STACK_INITIAL_SIZE : 2 * g_pretenured_cap;
+        p_new_chunks = realloc(g_pretenured, new_cap * sizeof(void *));
+        if (p_new_chunks == NULL)
+        {
+            return false;
+        }
+
+        g_pretenured = p_new_chunks;
+        g_pretenured_cap = new_cap;
+    }
+
+    g_pretenured[g_pretenured_len++] = ptr;
+
+    return true;
+}
+
+bool collector_defer_free(void *ptr)
+{
+    chunk_node *p_node;
+
+    if (!g_mark_active)
+    {
+        return false;
+    }
+
+    p_node = table_lookup(ptr);
+    if (p_node == NULL || !p_node->indexed)
+    {
+        return false;
+    }
+
+    p_node->dead = true; // ranges within the chunk may still be on the mark stack, so its memory has to stay valid until the sweep
+    weak_forget(ptr);
+
+    return true;
+}
+
+bool collector_survives(const void *ptr)
+{
+    size_t object;
+    chunk_node *p_node;
+    slab_page *p_page;
+
+    p_page = slab_find_page(ptr);
+    if (p_page != NULL)
+    {
+        object = (size_t) (ptr - p_page->base) / slab_object_size(p_page);
+
+        return !g_mark_slabs || (p_page->mark_bits[object / 64] & (UINT64_C(1) << (object % 64)));
+    }
+
+    p_node = table_lookup(ptr);
+
+    return p_node == NULL || !p_node->indexed || (p_node->reachable && !p_node->dead);
+}
+
+void collector_scan_next(mark_stack *p_stack)
+{
+    size_t slice;
+    mark_range range;
+
+    range = p_stack->p_ranges[--p_stack->len];
+    slice = collector_slice_words(range.p_layout);
+    if ((size_t) (range.end - range.start) > slice) // leave the rest of a long range on the stack where another marker may pick it up
+    {
+        p_stack->p_ranges[p_stack->len++].start = range.start + slice;
+        range.end = range.start + slice;
+    }
+
+    collector_scan(p_stack, range.start, range.end, range.gen, range.p_layout);
+
+    return;
+}
+
+void collector_drain(mark_stack *p_stack)
+{
+    while (p_stack->len > 0)
+    {
+        collector_scan_next(p_stack);
+    }
+
+    return;
+}
+
+void collector_free_stack(mark_stack *p_stack)
+{
+    if (p_stack->cap > 0)
+    {
+        munmap(p_stack->p_ranges, p_stack->cap * sizeof(mark_range));
+    }
+
+    p_stack->p_ranges = NULL;
+    p_stack->len = p_stack->cap = 0;
+
+    return;
+}
+
+void collector_free(void)
+{
+    collector_free_stack(&g_mark_stack);
+    g_mark_stack_overflow = false;
+    g_mark_active = g_mark_concurrent = false;
+    g_sweep_pending = false; // the chunks themselves are freed by `table_free()`
+
+    free(g_remark_chunks);
+    g_remark_chunks = NULL;
+    g_remark_chunks_len = g_remark_chunks_cap = 0;
+    g_remark_overflow = false;
+
+    free(g_pretenured);
+    g_pretenured = NULL;
+    g_pretenured_len = g_pretenured_cap = 0;
+
+    free(g_remember_buffer);
+    g_remember_buffer = NULL;
+    g_remember_buffer_len = g_remember_buffer_cap = 0;
+
+    free(g_roots);
+    g_roots = NULL;
+    g_roots_len = g_roots_cap = 0;
+
+    g_released_bytes = 0; // the statistics are reset as well
+
+    return;
+}
+
+void collector_sweep(bool to_collect[GENERATIONS])
+{
+    uint8_t gen;
+    size_t alloced_bytes, freed, live;
+    uint64_t start;
+
+    g_sweep_oldest = 0;
+    for (gen = 0; gen < GENERATIONS; gen++)
+    {
+        g_sweep_gens[gen] = to_collect[gen];
+        if (to_collect[gen])
+        {
+            g_sweep_oldest = gen;
+        }
+    }
+
+    if (to_collect[0]) // slab objects aren't tracked by generation and are collected along with the youngest one; only their bitmaps are touched, so this is cheap enough to do right away
+    {
+        start = stats_now_ns();
+        alloced_bytes = g_slab_alloced_bytes;
+        freed = slab_sweep(&live);
+        g_stats.gens[0].marked_chunks += live;
+        g_stats.gens[0].freed_chunks += freed;
+        g_stats.gens[0].freed_bytes += alloced_bytes - g_slab_alloced_bytes;
+        g_stats.gens[0].marked_bytes += g_slab_alloced_bytes;
+        g_stats.gens[g_sweep_oldest].sweep_ns += stats_now_ns() - start;
+    }
+
+    g_sweep_next = 0;
+    g_sweep_pending = true;
+
+    return;
+}
+
+void collector_sweep_step(size_t chunks)
+{
+    size_t swept;
+    uint64_t start;
+
+    if (!g_sweep_pending)
+    {
+        return;
+    }
+
+    stats_pause_begin();
+    start = stats_now_ns();
+
+    // Only the chunks in the index (those that existed when the collection started) are swept; later allocations
+    // were never given a chance to be marked
+    for (swept = 0; g_sweep_pending && swept < chunks; swept++)
+    {
+        if (g_sweep_next == g_chunk_index_len) // swept everything
+        {
+            g_sweep_pending = false;
+            remset_compact();
+            release_freed(); // before measuring the process for the heap limit
+            pacing_update(g_sweep_gens);
+
+            break;
+        }
+
+        sweep_chunk(g_chunk_index[g_sweep_next]);
+        g_chunk_index[g_sweep_next++] = NULL;
+    }
+
+    g_stats.gens[g_sweep_oldest].sweep_ns += stats_now_ns() - start;
+    if (!g_sweep_pending)
+    {
+        stats_cycle_event(GCLIB_CYCLE_END);
+    }
+
+    stats_pause_end();
+
+    return;
+}
+
+void collector_sweep_finish(void)
+{
+    collector_sweep_step(SIZE_MAX);
+
+    return;
+}
+
+static void pacing_update(bool to_collect[GENERATIONS])
+{
+    uint8_t gen;
+    size_t growth, rss, headroom;
+
+    if (to_collect[0]) // a collection was just swept so measure what survived it
+    {
+        g_live_bytes = g_slab_alloced_bytes;
+        for (gen = 0; gen < GENERATIONS; gen++)
+        {
+            g_live_bytes += g_alloced_bytes[gen];
+            if (to_collect[gen])
+            {
+                g_gen_live_bytes[gen] = g_alloced_bytes[gen];
+            }
+        }
+    }
+
+    // Generation 0 is paced by how much was allocated since the last collection, compared against the size of the
+    // whole live heap. Older generations only grow through promotions, so they are paced by their own size instead.
+    growth = g_live_bytes / 100 * g_growth_percent;
+    g_collect_trigger = (growth > g_gen_budget[0]) ? growth : g_gen_budget[0];
+
+    for (gen = 1; gen < GENERATIONS; gen++)
+    {
+        growth = g_gen_live_bytes[gen] + g_gen_live_bytes[gen] / 100 * g_growth_percent;
+        g_gen_trigger[gen] = (growth > g_gen_budget[gen]) ? growth : g_gen_budget[gen];
+    }
+
+    // Close to the heap limit, collections come sooner so that the process doesn't outgrow it before the next one:
+    // only part of what is left below the limit may be allocated in between
+    g_limit_reached = false;
+    if (g_heap_limit > 0)
+    {
+        rss = memory_rss();
+        headroom = (rss < g_heap_limit) ? (g_heap_limit - rss) / 100 * HEAP_LIMIT_HEADROOM_PERCENT : 0;
+        if (headroom < HEAP_LIMIT_MIN_TRIGGER) // collecting all the time wouldn't leave the program any time to run
+        {
+            headroom = HEAP_LIMIT_MIN_TRIGGER;
+        }
+
+        if (g_collect_trigger > headroom)
+        {
+            g_collect_trigger = headroom;
+        }
+
+        g_limit_reached = rss >= g_heap_limit / 100 * HEAP_LIMIT_FULL_PERCENT;
+    }
+
+    return;
+}
+
+static void release_freed(void)
+{
+    uint8_t gen;
+    size_t freed;
+
+    freed = g_stats.compacted_bytes; // the memory compacted chunks were moved out of was freed as well
+    for (gen = 0; gen < GENERATIONS; gen++)
+    {
+        freed += g_stats.gens[gen].freed_bytes;
+    }
+
+    // `free()` keeps most of what it is given for later allocations, and giving it back to the system means going
+    // through every free chunk of the heap, so this is only worth it after large sweeps or when memory is tight
+    if (freed - g_released_bytes < MEMORY_RELEASE_BYTES && !g_limit_reached)
+    {
+        return;
+    }
+
+    g_released_bytes = freed;
+    memory_release();
+
+    return;
+}
+
+static void roots_push(void)
+{
+    size_t i;
+
+    // The program may unregister a range and free its memory at any time, so unlike the data segment, registered
+    // ranges are only ever scanned by the final pause
+    for (i = 0; i < g_roots_len; i++)
+    {
+        collector_push_root(&g_mark_stack, g_roots[i].start, g_roots[i].end, MARK_UNTRACKED, NULL);
+        g_stats.root_words[GCLIB_ROOT_REGISTERED] += g_roots[i].end - g_roots[i].start;
+    }
+
+    // So are the chunks whose finalizers have yet to be run, which the program doesn't necessarily reference anymore
+    g_stats.root_words[GCLIB_ROOT_REGISTERED] += weak_push_pending(&g_mark_stack);
+
+    // Regions can be destroyed at any time too
+    g_stats.root_words[GCLIB_ROOT_REGION_MEMORY] += region_push(&g_mark_stack);
+
+    return;
+}
+
+static void data_push(bool dirty_only)
+{
+    if (!g_scan_data)
+    {
+        return;
+    }
+
+    if (dirty_only)
+    {
+        g_stats.root_words[GCLIB_ROOT_DATA] += dirty_push(g_data_start_ptr, g_data_end_ptr, MARK_UNTRACKED);
+    }
+    else
+    {
+        collector_push_root(&g_mark_stack, g_data_start_ptr, g_data_end_ptr, MARK_UNTRACKED, NULL);
+        g_stats.root_words[GCLIB_ROOT_DATA] += g_data_end_ptr - g_data_start_ptr;
+    }
+
+    return;
+}
+
+static size_t dirty_push(const void **start, const void **end, uint8_t gen)
+{
+    size_t words;
+    const void **page, **next, **run_start;
+
+    // Push each run of consecutive dirty pages as a single range
+    words = 0;
+    run_start = NULL;
+    for (page = start; page < end; page = next)
+    {
+        next = (const void **) (((uintptr_t) page / g_dirty_page_size + 1) * g_dirty_page_size);
+        if (next > end)
+        {
+            next = end;
+        }
+
+        if (dirty_range(page, next))
+        {
+            if (run_start == NULL)
+            {
+                run_start = page;
+            }
+        }
+        else if (run_start != NULL)
+        {
+            collector_push_root(&g_mark_stack, run_start, page, gen, NULL);
+            words += page - run_start;
+            run_start = NULL;
+        }
+    }
+
+    if (run_start != NULL)
+    {
+        collector_push_root(&g_mark_stack, run_start, end, gen, NULL);
+        words += end - run_start;
+    }
+
+    return words;
+}
+
+static void remark_push(void)
+{
+    size_t i, object, object_size;
+    const void **object_start, **object_end;
+    chunk_node *p_node;
+    slab_page *p_page;
+
+    collector_merge_remembered();
+
+    // The background thread may have scanned a marked chunk before the program stored a reference to an unmarked one
+    // into it. Such chunks are on pages that were written to, which are scanned again (the other marked chunks are
+    // up to date, and unmarked ones are scanned in full if they turn out to be reachable after all).
+    for (i = 0; i < g_chunk_index_len; i++)
+    {
+        p_node = g_chunk_index[i];
+        if (!p_node->reachable || p_node->dead || (p_node->p_layout != NULL && p_node->p_layout->p_bitmap == NULL))
+        {
+            continue;
+        }
+
+        if (p_node->p_layout == NULL)
+        {
+            dirty_push(p_node->ptr, p_node->ptr + p_node->size, p_node->gen);
+        }
+        else if (dirty_range(p_node->ptr, p_node->ptr + p_node->size)) // ranges with a layout have to start at an element
+        {
+            collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+        }
+    }
+
+    for (i = 0; i < g_large_index_len; i++)
+    {
+        p_node = g_large_index[i];
+        if (!p_node->reachable || p_node->dead || (p_node->p_layout != NULL && p_node->p_layout->p_bitmap == NULL))
+        {
+            continue;
+        }
+
+        if (p_node->p_layout == NULL)
+        {
+            dirty_push(p_node->ptr, p_node->ptr + p_node->size, MARK_UNTRACKED);
+        }
+        else if (dirty_range(p_node->ptr, p_node->ptr + p_node->size))
+        {
+            collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, MARK_UNTRACKED, p_node->p_layout);
+        }
+    }
+
+    for (i = 0; g_mark_slabs && i < g_slab_page_count; i++)
+    {
+        p_page = g_slab_pages[i];
+        object_size = slab_object_size(p_page);
+        for (object = 0; !p_page->atomic && object < p_page->objects; object++)
+        {
+            object_start = p_page->base + object * object_size;
+            object_end = p_page->base + (object + 1) * object_size;
+            if ((p_page->mark_bits[object / 64] & (UINT64_C(1) << (object % 64))) && dirty_range(object_start, object_end))
+            {
+                collector_push_root(&g_mark_stack, object_start, object_end, MARK_UNTRACKED, NULL);
+            }
+        }
+    }
+
+    // Chunks allocated since the collection started aren't indexed, so they are neither marked nor swept by it. But
+    // they may hold the only references to indexed chunks, so their contents are scanned all the same.
+    for (i = 0; i < g_remark_chunks_len; i++)
+    {
+        p_node = table_lookup(g_remark_chunks[i]);
+        if (p_node != NULL && !p_node->indexed && (p_node->p_layout == NULL || p_node->p_layout->p_bitmap != NULL)) // it may have been freed since
+        {
+            collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+        }
+    }
+    g_remark_chunks_len = 0;
+
+    for (i = 0; g_remark_overflow && i < g_chunk_table_cap; i++)
+    {
+        p_node = g_chunk_table[i];
+        if (p_node != NULL && !p_node->indexed && p_node->gen == 0 && (p_node->p_layout == NULL || p_node->p_layout->p_bitmap != NULL))
+        {
+            collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+        }
+    }
+
+    // Looking through the chunk table for chunks in generation 0 misses those allocated straight into an older one, but
+    // they are all still waiting in `g_pretenured` to be scanned by the next collection
+    for (i = 0; g_remark_overflow && i < g_pretenured_len; i++)
+    {
+        p_node = table_lookup(g_pretenured[i]);
+        if (p_node != NULL && !p_node->indexed && (p_node->p_layout == NULL || p_node->p_layout->p_bitmap != NULL))
+        {
+            collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+        }
+    }
+    g_remark_overflow = false;
+
+    return;
+}
+
+static void pretenured_push(void)
+{
+    size_t i, kept;
+    uint8_t age;
+    chunk_node *p_node;
+
+    // A chunk allocated straight into an older generation may have been initialized without `gclib_write_ptr()`, even
+    // after another thread started a collection, so it is scanned by as many collections as would have traced it in
+    // generation 0. That marks what it references and remembers the words of it that reference younger chunks. Chunks
+    // that are being collected are traced anyway, and their age is counted by the sweep.
+    kept = 0;
+    for (i = 0; i < g_pretenured_len; i++)
+    {
+        p_node = table_lookup(g_pretenured[i]);
+        if (p_node == NULL || p_node->gen == 0) // it may have been freed since, and its address reused
+        {
+            continue;
+        }
+
+        age = p_node->age + 1;
+        if (!p_node->indexed)
+        {
+            if (p_node->p_layout == NULL || p_node->p_layout->p_bitmap != NULL)
+            {
+                collector_push_root(&g_mark_stack, p_node->ptr, p_node->ptr + p_node->size, p_node->gen, p_node->p_layout);
+            }
+
+            p_node->age = age;
+        }
+
+        if (age < g_tenure_age)
+        {
+            g_pretenured[kept++] = g_pretenured[i];
+        }
+    }
+    g_pretenured_len = kept;
+
+    return;
+}
+
+static void mark_finish(void)
+{
+    ucontext_t context;
+    mutator *p_mutator;
+
+    if (g_mark_concurrent) // whatever the background thread didn't get to is left on the mark stack
+    {
+        marker_background_wait(true);
+    }
+
+    // The other threads may be holding locks inside `malloc()`, so nothing is allocated or freed through it while they
+    // are stopped. The index is built beforehand since the chunk table only changes while `g_gclib_lock` is held, and
+    // room is made for the finalizers that may be queued and the chunks that may be moved. The mark stacks and the
+    // remembered set, which can't be sized up front, are mapped on their own.
+    weak_reserve();
+    if (g_mark_compact)
+    {
+        compact_reserve();
+    }
+
+    mutator_stop_world();
+
+    // References that only live in registers (including the callee-saved ones of our callers) are spilled onto the
+    // stack by `getcontext()`, right below the frames of the calling thread. Whatever `getcontext()` doesn't fill in
+    // would otherwise be leftovers from deeper calls that keep dead chunks alive.
+    memset(&context, 0, sizeof(ucontext_t));
+    getcontext(&context);
+    if (g_mutator_self != NULL)
+    {
+        collector_push_root(&g_mark_stack, (const void **) &context, g_mutator_self->stack_base, MARK_UNTRACKED, NULL);
+        g_stats.root_words[GCLIB_ROOT_STACKS] += g_mutator_self->stack_base - (const void **) &context;
+    }
+    else // a thread that isn't registered has no known stack, so at least scan its registers
+    {
+        collector_push_root(&g_mark_stack, (const void **) &context, (const void **) (&context + 1), MARK_UNTRACKED, NULL);
+        g_stats.root_words[GCLIB_ROOT_STACKS] += sizeof(ucontext_t) / sizeof(void *);
+    }
+
+    for (p_mutator = g_mutators; p_mutator != NULL; p_mutator = p_mutator->next)
+    {
+        if (p_mutator->stopped)
+        {
+            collector_push_root(&g_mark_stack, (const void **) p_mutator->regs, (const void **) (p_mutator->regs + NGREG), MARK_UNTRACKED, NULL);
+            collector_push_root(&g_mark_stack, p_mutator->stack_top, p_mutator->stack_base, MARK_UNTRACKED, NULL);
+            g_stats.root_words[GCLIB_ROOT_STACKS] += NGREG + (p_mutator->stack_base - p_mutator->stack_top);
+        }
+    }
+
+    data_push(g_mark_concurrent);
+    roots_push();
+
+    if (g_mark_concurrent)
+    {
+        remark_push();
+        g_mark_concurrent = false;
+    }
+
+    // Threads only add the words they remembered on their own to the remembered set while holding `g_gclib_lock`, so
+    // scanning it wouldn't need them to be stopped. But a collection that isn't incremental has nothing better to do,
+    // and a concurrent one leaves it alone since the program adds to it while the background thread runs. Whatever the
+    // threads haven't added yet is added now (and shaded if an incremental collection already scanned the set).
+    collector_merge_barriers();
+    while (g_remset_pending)
+    {
+        remset_scan(SIZE_MAX);
+    }
+
+    collector_mark();
+
+    // Unreachable chunks with finalizers are kept alive (along with everything they reference) until the finalizers
+    // have been run, which happens once the other threads are running again
+    if (weak_process(&g_mark_stack))
+    {
+        collector_mark();
+    }
+
+    g_mark_active = false;
+    g_stats.gens[g_cycle_oldest].mark_ns += stats_now_ns() - g_cycle_start_ns;
+
+    if (g_mark_compact) // the moved chunks have to be in place before the other threads resume
+    {
+        compact_run();
+    }
+
+    // Slab objects are swept before the other threads resume since they may allocate from their pages at any time
+    collector_sweep(g_mark_gens);
+    mutator_start_world();
+    sweep_large();
+    slab_release_empty();
+
+    if (g_mark_compact)
+    {
+        compact_finish();
+        g_mark_compact = false;
+    }
+
+    return;
+}
+
+static uint8_t promoted_gen(uint8_t gen)
+{
+    return (gen < g_generations - 1) ? gen + 1 : gen;
+}
+
+static uint8_t surviving_gen(const chunk_node *p_node)
+{
+    // Must agree with `sweep_chunk()`
+    if (p_node->large || p_node->age + 1 < g_tenure_age)
+    {
+        return p_node->gen;
+    }
+
+    return promoted_gen(p_node->gen);
+}
+
+static void generations_apply(void)
+{
+    uint8_t gen;
+
+    g_tenure_age = g_next_tenure_age;
+    if (g_next_generations == g_generations)
+    {
+        return;
+    }
+
+    // What was left in the generations that are no longer in use is now in the oldest one
+    for (gen = g_next_generations; gen < g_generations; gen++)
+    {
+        g_gen_live_bytes[g_next_generations - 1] += g_gen_live_bytes[gen];
+        g_gen_live_bytes[gen] = 0;
+    }
+
+    table_set_generations(g_next_generations);
+    g_stats.generations = g_generations;
+    pacing_update((bool [GENERATIONS]) { false });
+
+    return;
+}
+
+static void remset_scan(size_t cards)
+{
+    size_t idx, end;
+    uint8_t word;
+    bool keep;
+    const void **ptr;
+    chunk_node *p_node;
+
+    // Growing the remembered set rehashes every card, so start over. Cards that were already scanned are simply
+    // scanned again, which finds nothing new.
+    if (g_remset_cap != g_remset_scan_cap)
+    {
+        g_remset_next = 0;
+        g_remset_scan_cap = g_remset_cap;
+    }
+
+    end = (g_remset_cap - g_remset_next > cards) ? g_remset_next + cards : g_remset_cap;
+    for (idx = g_remset_next; idx < end; idx++)
+    {
+        for (word = 0; g_remset[idx].card != 0 && word < CARD_WORDS; word++)
+        {
+            if (!(g_remset[idx].words & (UINT64_C(1) << word)))
+            {
+                continue;
+            }
+
+            ptr = (const void **) ((g_remset[idx].card << CARD_SHIFT) + word * sizeof(void *));
+
+            // Dead slab objects aren't forgotten when they are swept, but their pages stay valid until they are released
+            if (slab_find_page(ptr) != NULL && !slab_is_allocated(ptr))
+            {
+                g_remset[idx].words &= ~(UINT64_C(1) << word);
+
+                continue;
+            }
+
+            collector_scan(&g_mark_stack, ptr, ptr + 1, MARK_UNTRACKED, NULL); // only pushes onto the mark stack, so `g_remset` can't change underneath
+            g_stats.root_words[GCLIB_ROOT_REMSET]++;
+
+            // Only keep the word while it may still point to a chunk younger than the one containing it, which is
+            // unknown here and so assumed to be in the oldest generation
+            p_node = table_find_chunk(*ptr);
+            if (p_node != NULL)
+            {
+                keep = surviving_gen(p_node) < g_generations - 1;
+            }
+            else if (slab_find_page(*ptr) != NULL)
+            {
+                keep = true;
+            }
+            else if ((p_node = table_lookup(*ptr)) != NULL) // the start of a chunk in a generation that isn't being collected, or of one allocated since an incremental collection started
+            {
+                keep = p_node->gen < g_generations - 1;
+            }
+            else if (*ptr < g_table_min_ptr || g_table_max_ptr <= *ptr) // not a reference to any chunk at all
+            {
+                keep = false;
+            }
+            else // maybe a pointer into a chunk in a generation that isn't being collected, which might not be the oldest
+            {
+                keep = g_mark_active || !g_mark_gens[g_generations - 2]; // only scanned when the oldest generation isn't collected, so there are at least two
+            }
+
+            if (!keep)
+            {
+                g_remset[idx].words &= ~(UINT64_C(1) << word);
+            }
+        }
+    }
+
+    g_remset_next = end;
+    g_remset_pending = end < g_remset_cap;
+
+    return;
+}
+
+static void remember(const void *ptr)
+{
+    size_t new_cap;
+    const void **p_new_buffer;
+
+    if (__atomic_load_n(&g_mark_background, __ATOMIC_RELAXED)) // the program may be adding to the remembered set at the same time
+    {
+        if (g_remember_buffer_len == g_remember_buffer_cap)
+        {
+            new_cap = (g_remember_buffer_cap == 0) ? MARK_STACK_INITIAL_SIZE : 2 * g_remember_buffer_cap;
+            p_new_buffer = realloc(g_remember_buffer, new_cap * sizeof(const void *));
+            if (p_new_buffer == NULL) // rescanning every marked chunk in `collector_mark()` finds the word again
+            {
+                __atomic_store_n(&g_mark_stack_overflow, true, __ATOMIC_RELAXED);
+
+                return;
+            }
+
+            g_remember_buffer = p_new_buffer;
+            g_remember_buffer_cap = new_cap;
+        }
+
+        g_remember_buffer[g_remember_buffer_len++] = ptr;
+    }
+    else if (g_mark_parallel)
+    {
+        pthread_mutex_lock(&g_remset_lock);
+        remset_add(ptr);
+        pthread_mutex_unlock(&g_remset_lock);
+    }
+    else
+    {
+        remset_add(ptr);
+    }
+
+    return;
+}
+
+static void sweep_chunk(chunk_node *p_node)
+{
+    void *ptr;
+
+    if (p_node->ptr == NULL) // the program freed the chunk itself after it was indexed, leaving only the node
+    {
+        table_release_node(p_node);
+
+        return;
+    }
+
+    p_node->indexed = false;
+
+    if (p_node->site != 0 && p_node->gen == 0 && p_node->age == 0) // the first collection the chunk took part in
+    {
+        site_note_sweep(p_node->site, p_node->reachable && !p_node->dead);
+    }
+
+    if (p_node->reachable && !p_node->dead) // promote to next generation once it is old enough
+    {
+        p_node->reachable = p_node->pinned = false; // set up for next mark-cycle
+        g_stats.gens[p_node->gen].marked_chunks++;
+        g_stats.gens[p_node->gen].marked_bytes += p_node->size;
+
+        // Chunks in the highest generation can't be promoted, large chunks stay in generation 0 so that moving them never
+        // has to be paid for by the older generations, and the others have to be old enough
+        if (surviving_gen(p_node) != p_node->gen)
+        {
+            g_stats.gens[p_node->gen].promoted_chunks++;
+            g_stats.gens[p_node->gen].promoted_bytes += p_node->size;
+            table_set_gen(p_node, p_node->gen + 1);
+        }
+        else if (p_node->age < UINT8_MAX)
+        {
+            p_node->age++;
+        }
+    }
+    else // unreachable chunk (or one the program freed during an incremental collection); free it
+    {
+        g_stats.gens[p_node->gen].freed_chunks++;
+        g_stats.gens[p_node->gen].freed_bytes += p_node->size;
+        ptr = p_node->ptr;
+        compact_free(ptr, table_remove(ptr));
+    }
+
+    return;
+}
+
+static void sweep_large(void)
+{
+    size_t i;
+    uint64_t start;
+
+    // Large chunks are few, so they are swept right away, which also lets their index go. Freeing them takes the
+    // other threads to be running again, since one of them may be holding a lock inside `malloc()`.
+    start = stats_now_ns();
+    for (i = 0; i < g_large_index_len; i++)
+    {
+        sweep_chunk(g_large_index[i]);
+    }
+
+    g_large_index_len = 0;
+    g_large_min_ptr = g_large_max_ptr = NULL;
+    g_stats.gens[g_sweep_oldest].sweep_ns += stats_now_ns() - start;
+
+    return;
+}
+
+static void scan_ambiguous(mark_stack *p_stack, const void **start, const void **end, uint8_t gen)
+{
+    const void **block, **block_end, **word, **candidates[SCAN_BLOCK_WORDS];
+    size_t count, i, positions[SCAN_BLOCK_WORDS];
+    uintptr_t low, high;
+    uint64_t bits;
+    chunk_node *p_node;
+
+    // Words that could be references lie within the bounds of the indexed chunks or (when they are collected) of the
+    // slab pages. Both are read again for every range since the background thread may be marking while pages come
+    // and go (under `slab_lock_pages()`).
+    low = UINTPTR_MAX;
+    high = 0;
+    if (g_heap_min_ptr < g_heap_max_ptr)
+    {
+        low = (uintptr_t) g_heap_min_ptr;
+        high = (uintptr_t) g_heap_max_ptr;
+    }
+
+    if (g_mark_slabs && g_slab_min_ptr < g_slab_max_ptr)
+    {
+        low = ((uintptr_t) g_slab_min_ptr < low) ? (uintptr_t) g_slab_min_ptr : low;
+        high = ((uintptr_t) g_slab_max_ptr > high) ? (uintptr_t) g_slab_max_ptr : high;
+    }
+
+    for (block = start; low < high && block < end; block = block_end)
+    {
+        block_end = (end - block > SCAN_BLOCK_WORDS) ? block + SCAN_BLOCK_WORDS : end;
+
+        // Most words of a typical range are integers, characters, or null, which are rejected without a single branch.
+        // The binary search for each remaining word only touches the packed start addresses, and the node it ends at is
+        // prefetched, so that the cache misses for every candidate in the block are taken at once instead of in turn.
+        count = 0;
+        for (bits = g_scan_filter(block, block_end - block, low, high - low); bits != 0; bits &= bits - 1)
+        {
+            candidates[count] = block + __builtin_ctzll(bits);
+            positions[count] = table_find_index(*candidates[count]);
+            if (positions[count] != SIZE_MAX)
+            {
+                __builtin_prefetch(g_chunk_index[positions[count]]);
+            }
+
+            count++;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            p_node = NULL;
+            if (positions[i] != SIZE_MAX)
+            {
+                p_node = g_chunk_index[positions[i]];
+                if (*candidates[i] < p_node->ptr || p_node->ptr + p_node->size <= *candidates[i]) // past the end of the chunk, or the word changed since it was filtered
+                {
+                    p_node = table_find_large(*candidates[i]); // which may lie between the other chunks
+                }
+            }
+
+            scan_word(p_stack, candidates[i], p_node, gen, true);
+        }
+    }
+
+    // The large chunks have bounds of their own, which would let most integers through if they were merged with those
+    // above. Their index is only as long as there are large chunks, so each candidate is simply looked up.
+    if (g_large_index_len == 0 || g_large_min_ptr >= g_large_max_ptr)
+    {
+        return;
+    }
+
+    low = (uintptr_t) g_large_min_ptr;
+    high = (uintptr_t) g_large_max_ptr;
+    for (block = start; block < end; block = block_end)
+    {
+        block_end = (end - block > SCAN_BLOCK_WORDS) ? block + SCAN_BLOCK_WORDS : end;
+        for (bits = g_scan_filter(block, block_end - block, low, high - low); bits != 0; bits &= bits - 1)
+        {
+            word = block + __builtin_ctzll(bits);
+            p_node = table_find_large(*word);
+            if (p_node != NULL && table_find_index(*word) == SIZE_MAX) // words within the other bounds were handled above
+            {
+                scan_word(p_stack, word, p_node, gen, true);
+            }
+        }
+    }
+
+    return;
+}
+
+static uint64_t filter_scalar(const void **block, size_t words, uintptr_t low, uintptr_t span)
+{
+    size_t i;
+    uint64_t bits;
+
+    // One unsigned comparison per word checks both bounds since words below `low` wrap around to huge offsets
+    bits = 0;
+    for (i = 0; i < words; i++)
+    {
+        bits |= (uint64_t) ((uintptr_t) block[i] - low < span) << i;
+    }
+
+    return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t filter_avx2(const void **block, size_t words, uintptr_t low, uintptr_t span)
+{
+    size_t i;
+    uint64_t bits;
+    __m256i offsets, bias, vlow, vspan;
+
+    // AVX2 only compares signed 64-bit integers, so both sides are biased by 2^63 to compare them as unsigned
+    bias = _mm256_set1_epi64x(INT64_MIN);
+    vlow = _mm256_set1_epi64x((int64_t) low);
+    vspan = _mm256_xor_si256(_mm256_set1_epi64x((int64_t) span), bias);
+
+    bits = 0;
+    for (i = 0; i + 4 <= words; i += 4)
+    {
+        offsets = _mm256_xor_si256(_mm256_sub_epi64(_mm256_loadu_si256((const __m256i *) (block + i)), vlow), bias);
+        bits |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vspan, offsets))) << i;
+    }
+
+    if (i < words) // shifting by all 64 bits would be undefined
+    {
+        bits |= filter_scalar(block + i, words - i, low, span) << i;
+    }
+
+    return bits;
+}
+
+static void scan_word(mark_stack *p_stack, const void **ptr, chunk_node *p_current, uint8_t gen, bool ambiguous)
+{
+    const void **object_start, **object_end;
+
+    // `p_current` is the indexed chunk `*ptr` points into, if any; only chunks in the generations being collected are indexed
+    if (p_current != NULL) // `ptr` is the address of a reference to `p_current`
+    {
+        // Promoting the survivors can turn a reference between two collected chunks into one from an older chunk to a
+        // younger one without the program ever writing to it, so it has to be remembered here
+        if (gen != MARK_UNTRACKED && surviving_gen(p_current) < promoted_gen(gen)) // the chunk containing `ptr` may be promoted while `p_current` stays
+        {
+            remember(ptr);
+        }
+
+        // A word that isn't known to hold a reference can't be rewritten when the chunk moves, so it has to stay put
+        if (ambiguous && g_mark_compact && !p_current->pinned)
+        {
+            __atomic_store_n(&p_current->pinned, true, __ATOMIC_RELAXED);
+        }
+
+        // Check before claiming the chunk so that the common case of an already marked chunk needs no atomic operation
+        if (!p_current->reachable && !__atomic_exchange_n(&p_current->reachable, true, __ATOMIC_RELAXED) && (p_current->p_layout == NULL || p_current->p_layout->p_bitmap != NULL))
+        {
+            // Incrementing `p_current->ptr` (which is `void *`) below only works because with GCC, `sizeof(void)` is 1
+            // Casting to `char *` and then `void *` is technically more correct (and portable) but makes the code harder to understand
+            collector_push(p_stack, p_current->ptr, p_current->ptr + p_current->size, p_current->large ? MARK_UNTRACKED : p_current->gen, p_current->p_layout); // since this chunk is reachable, any chunk it references is also reachable (and a large one is never promoted past the chunks it references)
+        }
+    }
+    else if (g_mark_slabs)
+    {
+        if (gen != MARK_UNTRACKED && slab_is_allocated(*ptr)) // slab objects are never promoted so every chunk that survives is older
+        {
+            remember(ptr);
+        }
+
+        if (slab_mark(*ptr, &object_start, &object_end) && object_start < object_end)
+        {
+            collector_push(p_stack, object_start, object_end, MARK_UNTRACKED, NULL);
+        }
+    }
+
+    return;
+}
@@ -3,21 +3,148 @@
 #define GCLIB_COLLECTOR_H
 
 
+#include "gclib-remset.h"
+#include "gclib-slab.h"
 #include "gclib-table.h"
 
-extern const void **g_stack_start_ptr;
-extern const void **g_stack_end_ptr;
+/* A range of memory that is waiting to be scanned for references during the mark phase. */
+typedef struct mark_range
+{
+    const void **start;
+    const void **end;
+    uint8_t gen; // generation of the chunk being scanned, or `MARK_UNTRACKED`
+    const gclib_layout *p_layout; // which words of the range may hold references, or `NULL` if any of them may; ranges with a layout start at the beginning of an element
+} mark_range;
+
+/* A range of memory registered by the program as holding references to chunks. */
+typedef struct root_range
+{
+    const void **start;
+    const void **end;
+} root_range;
+
+/* A growable stack of `mark_range`s that are waiting to be scanned. */
+typedef struct mark_stack
+{
+    mark_range *p_ranges;
+    size_t len;
+    size_t cap;
+} mark_stack;
+
+#define MARK_STACK_INITIAL_SIZE 1024
+#define ROOTS_INITIAL_SIZE 16
+#define MARK_SLICE_WORDS 4096    // ranges longer than this are scanned a slice at a time so that they can be shared between markers
+#define MARK_UNTRACKED UINT8_MAX // "generation" of roots and slab objects, which never need to be remembered
+#define SCAN_BLOCK_WORDS 64      // number of words that are filtered against the heap bounds at once when scanning a range that isn't laid out
+#define SWEEP_STEP_CHUNKS 64     // number of chunks swept by each allocation while a sweep is pending
+#define REMSET_SCAN_CARDS 256    // number of slots of the remembered set scanned at a time by an incremental collection
+#define DEFAULT_GEN_BUDGET ((size_t) 1e+9) // default number of bytes a generation may take up (or for generation 0, be allocated) before it is collected; 1GB may not be optimal for actual use
+#define DEFAULT_GROWTH_PERCENT 100         // default growth of the heap (relative to its live size after the last collection) before the next collection
+#define DEFAULT_GENERATIONS 3              // default number of generations chunks are promoted through
+#define DEFAULT_TENURE_AGE 1               // default number of collections of its generation a chunk has to survive before it is promoted
+#define HEAP_LIMIT_HEADROOM_PERCENT 50     // percentage of what is left below the heap limit that may be allocated before the next collection
+#define HEAP_LIMIT_FULL_PERCENT 90         // percentage of the heap limit above which every collection includes every generation
+#define HEAP_LIMIT_MIN_TRIGGER (4 << 20)   // number of bytes that may always be allocated between collections, however close the heap is to its limit
+
 extern const void **g_data_start_ptr;
 extern const void **g_data_end_ptr;
+extern size_t g_alloc_debt;
+extern size_t g_collect_trigger;
+extern bool g_mark_stack_overflow;
+extern bool g_mark_parallel;
+extern bool g_sweep_pending;
+extern bool g_scan_data;
+extern bool g_mark_active;
+extern unsigned int g_pause_target;
+extern bool g_concurrent;
+extern size_t g_heap_limit;
 
-/* Run the garbage collector with the option to sweep through all generations. */
+/* Set the pacing policy to its defaults. */
+void collector_init(void);
+
+/* Run the garbage collector with the option to sweep through all generations. Unless `all_gens` is set, nothing happens until `g_alloc_debt` reaches `g_collect_trigger`, and the collection only starts marking if `g_concurrent` or `g_pause_target` is set. Finishes an incremental or concurrent collection that is under way first. */
 void collector_run(bool all_gens);
 
-/* Mark all `chunk_nodes` within the generations to collect as reachable that have references between `*start` and `*end`. */
-void collector_mark(bool to_collect[GENERATIONS], const void **start, const void **end);
+/* Register `*start` through `*end` as an additional root range that is scanned by every collection. Return whether there was enough memory to do so. */
+bool collector_add_root(const void **start, const void **end);
+
+/* Unregister the most recently registered root range starting at `start`, if any. */
+void collector_remove_root(const void **start);
+
+/* Set the number of bytes generation `gen` may take up (or for generation 0, be allocated) before it is collected. */
+void collector_set_budget(uint8_t gen, size_t bytes);
+
+/* Set how far (as a percentage of its live size after the last collection) the heap may grow before it is collected again. */
+void collector_set_growth(unsigned int percent);
+
+/* Set the number of bytes the resident set size of the process should stay below, or 0 for no limit. */
+void collector_set_limit(size_t bytes);
+
+/* Set the number of generations (from 1 to `GENERATIONS`) that the next collection and those after it use. */
+void collector_set_generations(uint8_t count);
+
+/* Set the number of collections a chunk has to survive before it is promoted, starting with the next collection. */
+void collector_set_tenure_age(uint8_t collections);
+
+/* Mark all indexed `chunk_nodes` (and slab objects, when generation 0 is being collected) as reachable that are referenced from the ranges on the mark stack, directly or through other reachable chunks. */
+void collector_mark(void);
+
+/* Push the range `*start` through `*end` (the contents of a chunk in generation `gen` laid out according to `*p_layout`) onto `*p_stack` to be scanned. Return `false` and set `g_mark_stack_overflow` if the stack couldn't grow, leaving the range for `collector_mark()` to find again among the marked chunks. */
+bool collector_push(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout);
+
+/* Push the range `*start` through `*end` onto `*p_stack` like `collector_push()`, or scan it right away if the stack couldn't grow. Used for roots and the other ranges that aren't the contents of a marked chunk. */
+void collector_push_root(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout);
+
+/* Scan the words of `*start` through `*end` (the contents of a chunk in generation `gen`) that `*p_layout` allows for references to unmarked indexed chunks and slab objects, marking them and pushing their contents onto `*p_stack`. Without a layout, words are first filtered a block at a time against the bounds of the heap and the slab pages. */
+void collector_scan(mark_stack *p_stack, const void **start, const void **end, uint8_t gen, const gclib_layout *p_layout);
 
-/* Sweep through the given generations and remove any `chunk_nodes` determined as unreachable. */
+/* Return the number of words a range laid out according to `*p_layout` may be split into without splitting an element. */
+size_t collector_slice_words(const gclib_layout *p_layout);
+
+/* Continue the incremental collection under way for at most `g_pause_target` microseconds, finishing it with a short pause once nothing is left to mark. A concurrent collection is only finished once the background thread is done. */
+void collector_mark_step(void);
+
+/* Mark what the range `*start` through `*end` (laid out according to `*p_layout`) references, if an incremental collection is under way. */
+void collector_shade(const void **start, const void **end, const gclib_layout *p_layout);
+
+/* Add the words that every registered thread remembered through `gclib_write_ptr()` since they were last merged to the remembered set, shading them as well if an incremental collection is under way. */
+void collector_merge_barriers(void);
+
+/* Add the words that the background thread found to need remembering to the remembered set, if the concurrent collection under way is done marking. */
+void collector_merge_remembered(void);
+
+/* Have the final pause of a concurrent collection under way scan the chunk at `ptr`, which was allocated or moved after the collection started. */
+void collector_note_alloc(void *ptr);
+
+/* Have the next collections scan the chunk at `ptr`, which was allocated straight into an older generation and may be initialized without `gclib_write_ptr()`, as often as they would have traced it in generation 0. Return whether there was enough memory to do so. */
+bool collector_note_pretenured(void *ptr);
+
+/* Leave freeing the indexed chunk at `ptr` to the sweep if an incremental or concurrent collection is under way, since its contents may still be scanned. Return whether it was left. */
+bool collector_defer_free(void *ptr);
+
+/* Return whether the chunk or slab object starting at `ptr` survives the collection that just finished marking, either because it was marked or because it isn't part of the collection. */
+bool collector_survives(const void *ptr);
+
+/* Pop a range off of `*p_stack` and scan (at most `MARK_SLICE_WORDS` words of) it. */
+void collector_scan_next(mark_stack *p_stack);
+
+/* Pop and scan ranges off of `*p_stack` until it is empty. */
+void collector_drain(mark_stack *p_stack);
+
+/* Unmap the ranges of `*p_stack`, leaving it empty. */
+void collector_free_stack(mark_stack *p_stack);
+
+/* Free the memory used internally by the collector. */
+void collector_free(void);
+
+/* Start sweeping through the given generations, which is then done a few chunks at a time by `collector_sweep_step()`. Slab objects are swept right away, and large chunks as soon as the other threads are running again. */
 void collector_sweep(bool to_collect[GENERATIONS]);
 
+/* Continue the pending sweep through (at most) the next `chunks` indexed chunks, freeing those determined as unreachable and promoting the rest. */
+void collector_sweep_step(size_t chunks);
+
+/* Finish the pending sweep, if any. */
+void collector_sweep_finish(void);
+
 
 #endif // GCLIB_COLLECTOR_H
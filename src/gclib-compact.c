@@ -0,0 +1,481 @@
+#include <string.h>
+#include <sys/mman.h>
+
+#include "gclib-compact.h"
+#include "gclib-large.h"
+#include "gclib-stats.h"
+#include "gclib-table.h"
+
+bool g_compact_enabled; // whether full collections that mark in a single pause evacuate the oldest generation
+
+static compact_region **g_regions;   // regions chunks were evacuated into, sorted by address
+static size_t g_region_count;        // number of regions in `g_regions`
+static size_t g_region_cap;          // number of regions `g_regions` has room for, which only `compact_reserve()` adds to
+static const void *g_region_min_ptr; // lowest address covered by a region
+static const void *g_region_max_ptr; // address one past the highest address covered by a region
+static compact_region *g_p_target;   // region that chunks are evacuated into next, or `NULL` if a new one has to be created first
+static compact_move *g_moves;        // chunks moved by the current compaction, sorted by their old address
+static size_t g_moves_len;           // number of moves in `g_moves`
+static size_t g_moves_cap;           // number of moves `g_moves` has room for, which only `compact_reserve()` adds to
+
+static void moves_select(void);
+static void moves_fixup(void **start, void **end, const gclib_layout *p_layout);
+static void moves_apply(void);
+static void *forward(void *ptr);
+static void *region_alloc(size_t size);
+static compact_region *region_find(const void *ptr);
+static compact_region *region_create(void);
+static void region_release(compact_region *p_region);
+static void regions_update_bounds(void);
+static size_t aligned_size(size_t size);
+
+void compact_reserve(void)
+{
+    size_t new_cap, regions;
+    compact_move *p_new_moves;
+    compact_region **p_new_regions;
+
+    // Every indexed chunk may have to move, and every byte of the oldest generation may have to go into a new region,
+    // the end of which is left unused whenever the next chunk doesn't fit anymore. Reserving less only means that
+    // fewer chunks move.
+    new_cap = (g_moves_cap == 0) ? COMPACT_MOVES_INITIAL_SIZE : g_moves_cap;
+    while (new_cap < g_chunk_index_len)
+    {
+        new_cap *= 2;
+    }
+
+    if (new_cap > g_moves_cap)
+    {
+        p_new_moves = realloc(g_moves, new_cap * sizeof(compact_move));
+        if (p_new_moves != NULL)
+        {
+            g_moves = p_new_moves;
+            g_moves_cap = new_cap;
+        }
+    }
+
+    regions = g_region_count + g_alloced_bytes[g_generations - 1] / (COMPACT_REGION_CAPACITY - COMPACT_MAX_SIZE) + 1;
+    new_cap = (g_region_cap == 0) ? COMPACT_REGIONS_INITIAL_SIZE : g_region_cap;
+    while (new_cap < regions)
+    {
+        new_cap *= 2;
+    }
+
+    if (new_cap > g_region_cap)
+    {
+        p_new_regions = realloc(g_regions, new_cap * sizeof(compact_region *));
+        if (p_new_regions != NULL)
+        {
+            g_regions = p_new_regions;
+            g_region_cap = new_cap;
+        }
+    }
+
+    return;
+}
+
+void compact_run(void)
+{
+    size_t idx;
+    chunk_node *p_node;
+    compact_region *p_region;
+
+    // Regions that have become sparse are emptied into new ones along with the chunks that are still where
+    // `malloc()` put them
+    for (idx = 0; idx < g_region_count; idx++)
+    {
+        p_region = g_regions[idx];
+        p_region->evacuating = p_region->live * 100 < p_region->used * COMPACT_SPARSE_PERCENT;
+        if (p_region->evacuating && p_region == g_p_target)
+        {
+            g_p_target = NULL;
+        }
+    }
+
+    moves_select();
+
+    // Every reference that may have to be rewritten is in a word that some layout describes, since any other word
+    // referencing a chunk pinned it. References within the moved chunks are rewritten before they are copied.
+    for (idx = 0; g_moves_len > 0 && idx < g_chunk_index_len; idx++)
+    {
+        p_node = g_chunk_index[idx];
+        if (p_node->reachable && !p_node->dead && p_node->p_layout != NULL && p_node->p_layout->p_bitmap != NULL)
+        {
+            moves_fixup(p_node->ptr, p_node->ptr + p_node->size, p_node->p_layout);
+        }
+    }
+
+    // Large chunks never move themselves but are traced like any other, so their layouts may describe references too
+    for (idx = 0; g_moves_len > 0 && idx < g_large_index_len; idx++)
+    {
+        p_node = g_large_index[idx];
+        if (p_node->reachable && !p_node->dead && p_node->p_layout != NULL && p_node->p_layout->p_bitmap != NULL)
+        {
+            moves_fixup(p_node->ptr, p_node->ptr + p_node->size, p_node->p_layout);
+        }
+    }
+
+    moves_apply();
+
+    return;
+}
+
+void compact_finish(void)
+{
+    size_t idx;
+
+    // Freeing through `free()` while the other threads are stopped could deadlock on a lock one of them holds
+    for (idx = 0; idx < g_moves_len; idx++)
+    {
+        compact_free(g_moves[idx].old_ptr, g_moves[idx].size);
+    }
+
+    g_moves_len = 0;
+
+    for (idx = 0; idx < g_region_count; idx++)
+    {
+        g_regions[idx]->evacuating = false;
+    }
+
+    return;
+}
+
+void compact_free(void *ptr, size_t size)
+{
+    compact_region *p_region;
+
+    p_region = region_find(ptr);
+    if (p_region == NULL)
+    {
+        if (!large_free(ptr, size))
+        {
+            free(ptr);
+        }
+
+        return;
+    }
+
+    p_region->live -= aligned_size(size);
+    if (p_region->live == 0)
+    {
+        if (p_region == g_p_target) // nothing is left in it, so fill it up from the start again
+        {
+            p_region->used = 0;
+        }
+        else
+        {
+            region_release(p_region);
+        }
+    }
+
+    return;
+}
+
+void *compact_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+    void *new_ptr;
+
+    if (region_find(ptr) == NULL)
+    {
+        return large_owns(ptr) ? large_realloc(ptr, old_size, new_size) : realloc(ptr, new_size);
+    }
+
+    if (new_size == 0)
+    {
+        compact_free(ptr, old_size);
+
+        return NULL;
+    }
+
+    // Chunks can't grow in place within a region, and the space a shrinking one gives up can't be reused either
+    new_ptr = malloc(new_size);
+    if (new_ptr == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, (new_size < old_size) ? new_size : old_size);
+    compact_free(ptr, old_size);
+
+    return new_ptr;
+}
+
+void compact_free_all(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < g_region_count; idx++)
+    {
+        munmap(g_regions[idx]->base, COMPACT_REGION_SIZE); // along with the `compact_region` itself
+    }
+
+    free(g_regions);
+    g_regions = NULL;
+    g_region_count = g_region_cap = 0;
+    g_p_target = NULL;
+    regions_update_bounds();
+
+    free(g_moves);
+    g_moves = NULL;
+    g_moves_len = g_moves_cap = 0;
+
+    return;
+}
+
+static void moves_select(void)
+{
+    size_t idx;
+    void *new_ptr;
+    chunk_node *p_node;
+    compact_region *p_region;
+
+    // The index is sorted by address, so the moves are as well, and the chunks keep their order in the regions
+    g_moves_len = 0;
+    for (idx = 0; idx < g_chunk_index_len; idx++)
+    {
+        p_node = g_chunk_index[idx];
+        if (p_node->gen != g_generations - 1 || !p_node->reachable || p_node->dead)
+        {
+            continue;
+        }
+
+        if (p_node->pinned) // the program may hold its address anywhere, so it can't move
+        {
+            g_stats.pinned_chunks++;
+
+            continue;
+        }
+
+        p_region = region_find(p_node->ptr);
+        if (p_node->size > COMPACT_MAX_SIZE || (p_region != NULL && !p_region->evacuating))
+        {
+            continue;
+        }
+
+        if (g_moves_len == g_moves_cap) // `compact_reserve()` didn't find the memory for every chunk; whatever was selected so far still moves
+        {
+            return;
+        }
+
+        new_ptr = region_alloc(p_node->size);
+        if (new_ptr == NULL)
+        {
+            return;
+        }
+
+        g_moves[g_moves_len].old_ptr = p_node->ptr;
+        g_moves[g_moves_len].new_ptr = new_ptr;
+        g_moves[g_moves_len].size = p_node->size;
+        g_moves_len++;
+    }
+
+    return;
+}
+
+static void moves_fixup(void **start, void **end, const gclib_layout *p_layout)
+{
+    void **ptr, **element;
+    size_t words, bitmap_word;
+    uint64_t bits;
+
+    // Visit the same words as `collector_scan()` does for a chunk with a layout
+    words = p_layout->size / sizeof(void *);
+    for (element = start; element < end; element += words)
+    {
+        for (bitmap_word = 0; bitmap_word < (words + 63) / 64; bitmap_word++)
+        {
+            for (bits = p_layout->p_bitmap[bitmap_word]; bits != 0; bits &= bits - 1)
+            {
+                ptr = element + bitmap_word * 64 + __builtin_ctzll(bits);
+                if (ptr >= end)
+                {
+                    return;
+                }
+
+                *ptr = forward(*ptr);
+            }
+        }
+    }
+
+    return;
+}
+
+static void moves_apply(void)
+{
+    size_t idx;
+    compact_move *p_move;
+
+    for (idx = 0; idx < g_moves_len; idx++)
+    {
+        p_move = &g_moves[idx];
+        memcpy(p_move->new_ptr, p_move->old_ptr, p_move->size);
+        table_resize(p_move->old_ptr, p_move->new_ptr, p_move->size); // rehashes the chunk and moves its remembered words along with it
+
+        g_stats.compacted_chunks++;
+        g_stats.compacted_bytes += p_move->size;
+    }
+
+    return;
+}
+
+static void *forward(void *ptr)
+{
+    size_t low, high, mid;
+    compact_move *p_last;
+
+    p_last = &g_moves[g_moves_len - 1];
+    if (ptr < g_moves[0].old_ptr || p_last->old_ptr + p_last->size <= ptr) // cheap rejection of most words, just like `table_find_chunk()`
+    {
+        return ptr;
+    }
+
+    // Binary search for the last move whose chunk starts at or below `ptr`, which may point into its interior
+    low = 0;
+    high = g_moves_len;
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (g_moves[mid].old_ptr <= ptr)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (ptr < g_moves[low].old_ptr + g_moves[low].size)
+    {
+        return g_moves[low].new_ptr + (ptr - g_moves[low].old_ptr);
+    }
+
+    return ptr;
+}
+
+static void *region_alloc(size_t size)
+{
+    void *ptr;
+
+    size = aligned_size(size);
+    if (g_p_target == NULL || g_p_target->used + size > COMPACT_REGION_CAPACITY) // whatever is left at the end of a full region stays unused
+    {
+        g_p_target = region_create();
+        if (g_p_target == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    ptr = g_p_target->base + g_p_target->used;
+    g_p_target->used += size;
+    g_p_target->live += size;
+
+    return ptr;
+}
+
+static compact_region *region_find(const void *ptr)
+{
+    size_t low, high, mid;
+    compact_region *p_region;
+
+    if (ptr < g_region_min_ptr || g_region_max_ptr <= ptr)
+    {
+        return NULL;
+    }
+
+    // Binary search for the last region starting at or below `ptr`
+    low = 0;
+    high = g_region_count;
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (g_regions[mid]->base <= ptr)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    p_region = g_regions[low];
+    if (p_region->base <= ptr && ptr < p_region->base + COMPACT_REGION_SIZE)
+    {
+        return p_region;
+    }
+
+    return NULL;
+}
+
+static compact_region *region_create(void)
+{
+    size_t idx;
+    void *base;
+    compact_region *p_region;
+
+    if (g_region_count == g_region_cap)
+    {
+        return NULL;
+    }
+
+    // Mapped directly so that releasing an empty region always gives its memory back to the system. Regions are
+    // created while the other threads are stopped, so the `compact_region` is kept in the mapping (which zeroes it) as
+    // well instead of being allocated with `malloc()`.
+    base = mmap(NULL, COMPACT_REGION_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    p_region = base + COMPACT_REGION_CAPACITY;
+    p_region->base = base;
+
+    // Keep `g_regions` sorted by address
+    for (idx = g_region_count; idx > 0 && g_regions[idx - 1]->base > p_region->base; idx--)
+    {
+        g_regions[idx] = g_regions[idx - 1];
+    }
+    g_regions[idx] = p_region;
+    g_region_count++;
+    regions_update_bounds();
+
+    return p_region;
+}
+
+static void region_release(compact_region *p_region)
+{
+    size_t idx;
+
+    for (idx = 0; g_regions[idx] != p_region; idx++)
+        ;
+
+    memmove(&g_regions[idx], &g_regions[idx + 1], (g_region_count - idx - 1) * sizeof(compact_region *));
+    g_region_count--;
+    regions_update_bounds();
+
+    munmap(p_region->base, COMPACT_REGION_SIZE); // along with `*p_region`
+
+    return;
+}
+
+static void regions_update_bounds(void)
+{
+    if (g_region_count == 0)
+    {
+        g_region_min_ptr = g_region_max_ptr = NULL;
+
+        return;
+    }
+
+    g_region_min_ptr = g_regions[0]->base;
+    g_region_max_ptr = g_regions[g_region_count - 1]->base + COMPACT_REGION_SIZE;
+
+    return;
+}
+
+static size_t aligned_size(size_t size)
+{
+    return (size + COMPACT_ALIGN - 1) & ~(size_t) (COMPACT_ALIGN - 1);
+}
@@ -0,0 +1,57 @@
+#ifndef GCLIB_COMPACT_H
+#define GCLIB_COMPACT_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define COMPACT_REGION_SIZE (1 << 20)  // size of the memory backing each `compact_region`
+#define COMPACT_MAX_SIZE (128 << 10)   // size of the largest chunk that is evacuated; `malloc()` gives larger ones pages of their own anyway
+#define COMPACT_ALIGN 16               // alignment of the chunks in a region, which matches that of `malloc()`
+#define COMPACT_SPARSE_PERCENT 50      // regions whose chunks take up less than this percentage of their used space are evacuated themselves
+#define COMPACT_MOVES_INITIAL_SIZE 1024
+#define COMPACT_REGIONS_INITIAL_SIZE 16
+
+/* A contiguous range of memory that chunks are evacuated into, one after the other. */
+typedef struct compact_region
+{
+    void *base;
+    size_t used;     // number of bytes handed out from the start of the region
+    size_t live;     // number of bytes (rounded up to `COMPACT_ALIGN`) taken up by chunks that weren't freed yet
+    bool evacuating; // whether the current compaction moves the chunks out of the region
+} compact_region;
+
+#define COMPACT_REGION_CAPACITY (COMPACT_REGION_SIZE - sizeof(compact_region)) // bytes of a region that chunks can take up; its `compact_region` is kept in the rest
+
+/* A chunk that the current compaction moves to another address. */
+typedef struct compact_move
+{
+    void *old_ptr;
+    void *new_ptr;
+    size_t size;
+} compact_move;
+
+extern bool g_compact_enabled;
+
+/* Make room for the moves and regions that `compact_run()` may need for the indexed chunks, so that it doesn't have to allocate while the other threads are stopped. */
+void compact_reserve(void);
+
+/* Copy the reachable chunks of the oldest generation that aren't pinned (and aren't in a region that is dense enough already) into regions and rewrite every reference to them in the words that the layouts of the reachable chunks describe. Every indexed chunk must have been marked, and every other thread stopped. */
+void compact_run(void);
+
+/* Free the memory that `compact_run()` moved chunks out of, which no longer needs the other threads to be stopped. */
+void compact_finish(void);
+
+/* Free the chunk of `size` bytes at `ptr`, whether it lies in a region, was mapped on its own by `large_alloc()`, or was allocated with `malloc()`. */
+void compact_free(void *ptr, size_t size);
+
+/* Resize the chunk of `old_size` bytes at `ptr` to `new_size` bytes as `realloc()` does, moving it out into memory from `malloc()` if it lies in a region. Chunks mapped by `large_alloc()` stay mapped on their own. */
+void *compact_realloc(void *ptr, size_t old_size, size_t new_size);
+
+/* Release every region along with the chunks it contains. */
+void compact_free_all(void);
+
+
+#endif // GCLIB_COMPACT_H
@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gclib-dirty.h"
+
+bool g_dirty_tracked;             // whether the kernel keeps soft-dirty bits for the pages of this process
+size_t g_dirty_page_size = 4096;  // size of the pages whose soft-dirty bits are tracked
+
+static int g_pagemap_fd = -1;                 // /proc/self/pagemap, holding one 64-bit entry per page of the address space
+static int g_clear_refs_fd = -1;              // /proc/self/clear_refs, which clears every soft-dirty bit when "4" is written to it
+static uint64_t g_window[DIRTY_WINDOW_PAGES]; // pagemap entries of the pages starting at page number `g_window_start`
+static uintptr_t g_window_start;              // page number of `g_window[0]`
+static size_t g_window_len;                   // number of entries in `g_window` that were read successfully
+
+static bool window_load(uintptr_t page);
+
+bool dirty_init(void)
+{
+    volatile char *p_probe;
+
+    if (g_dirty_tracked)
+    {
+        return true;
+    }
+
+    g_dirty_page_size = sysconf(_SC_PAGESIZE);
+    g_pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    g_clear_refs_fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    p_probe = aligned_alloc(g_dirty_page_size, g_dirty_page_size);
+    if (g_pagemap_fd < 0 || g_clear_refs_fd < 0 || p_probe == NULL)
+    {
+        free((void *) p_probe);
+        dirty_free();
+
+        return false;
+    }
+
+    // Kernels built without soft-dirty support still accept writes to clear_refs but never set the bit, so check that
+    // writing to a page of our own after clearing actually shows up
+    p_probe[0] = 1;
+    g_dirty_tracked = true;
+    dirty_clear();
+    p_probe[0] = 2;
+    g_dirty_tracked = window_load((uintptr_t) p_probe / g_dirty_page_size) && (g_window[0] & (UINT64_C(1) << DIRTY_SOFT_DIRTY_BIT));
+    free((void *) p_probe);
+
+    if (!g_dirty_tracked)
+    {
+        dirty_free();
+    }
+
+    return g_dirty_tracked;
+}
+
+void dirty_clear(void)
+{
+    if (!g_dirty_tracked)
+    {
+        return;
+    }
+
+    // If this fails the old bits are simply left set, which only makes more pages look dirty than need be
+    if (pwrite(g_clear_refs_fd, "4", 1, 0) < 0)
+    {
+        return;
+    }
+
+    g_window_len = 0;
+
+    return;
+}
+
+bool dirty_range(const void *start, const void *end)
+{
+    uintptr_t page, last;
+
+    if (!g_dirty_tracked || start >= end)
+    {
+        return start < end;
+    }
+
+    last = ((uintptr_t) end - 1) / g_dirty_page_size;
+    for (page = (uintptr_t) start / g_dirty_page_size; page <= last; page++)
+    {
+        if ((page < g_window_start || page >= g_window_start + g_window_len) && !window_load(page))
+        {
+            return true; // can't tell, so assume the worst
+        }
+
+        if (g_window[page - g_window_start] & (UINT64_C(1) << DIRTY_SOFT_DIRTY_BIT))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void dirty_free(void)
+{
+    if (g_pagemap_fd >= 0)
+    {
+        close(g_pagemap_fd);
+    }
+
+    if (g_clear_refs_fd >= 0)
+    {
+        close(g_clear_refs_fd);
+    }
+
+    g_pagemap_fd = g_clear_refs_fd = -1;
+    g_dirty_tracked = false;
+    g_window_len = 0;
+
+    return;
+}
+
+static bool window_load(uintptr_t page)
+{
+    ssize_t bytes;
+
+    bytes = pread(g_pagemap_fd, g_window, sizeof(g_window), (off_t) (page * sizeof(uint64_t)));
+    if (bytes < (ssize_t) sizeof(uint64_t))
+    {
+        g_window_len = 0;
+
+        return false;
+    }
+
+    g_window_start = page;
+    g_window_len = bytes / sizeof(uint64_t);
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef GCLIB_DIRTY_H
+#define GCLIB_DIRTY_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIRTY_WINDOW_PAGES 512 // number of entries read from /proc/self/pagemap at a time
+#define DIRTY_SOFT_DIRTY_BIT 55 // bit of a pagemap entry that is set once the page was written to since the soft-dirty bits were last cleared
+
+extern bool g_dirty_tracked;
+extern size_t g_dirty_page_size;
+
+/* Find out whether the kernel keeps soft-dirty bits for the pages of this process, which is needed for `dirty_range()` to tell pages apart. Return whether it does. */
+bool dirty_init(void);
+
+/* Clear the soft-dirty bits of every page of the process, so that `dirty_range()` only reports the pages written to from now on. */
+void dirty_clear(void);
+
+/* Return whether any page overlapping `*start` through `*end` may have been written to since the last call to `dirty_clear()`, which is always the case when soft-dirty bits aren't tracked. Ranges are best passed in increasing order of address, which keeps the number of reads of /proc/self/pagemap down. */
+bool dirty_range(const void *start, const void *end);
+
+/* Close the files used to track soft-dirty bits. */
+void dirty_free(void);
+
+
+#endif // GCLIB_DIRTY_H
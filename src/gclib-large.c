@@ -0,0 +1,284 @@
+#define _GNU_SOURCE // for `mremap()`
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "gclib-large.h"
+#include "gclib-remset.h"
+
+size_t g_large_threshold = LARGE_DEFAULT_THRESHOLD; // size of the smallest chunk that is mapped on its own, or 0 if none are
+
+static void **g_large_ptrs;   // every chunk mapped by `large_alloc()` that is still mapped, sorted by address
+static size_t g_large_count;  // number of chunks in `g_large_ptrs`
+static size_t g_large_cap;    // number of chunks `g_large_ptrs` has room for
+static void *g_cache_ptrs[LARGE_CACHE_SLOTS];   // freed mappings kept for reuse, so that a program that keeps replacing large chunks doesn't fault in fresh pages for each
+static size_t g_cache_sizes[LARGE_CACHE_SLOTS]; // mapped size of each mapping in `g_cache_ptrs`
+static size_t g_cache_count;                    // number of mappings in `g_cache_ptrs`
+static size_t g_cache_bytes;                    // total size of the mappings in `g_cache_ptrs`
+
+static void *cache_take(size_t size);
+static bool cache_put(void *ptr, size_t size);
+static size_t ptrs_find(const void *ptr);
+static bool ptrs_insert(void *ptr);
+static void ptrs_delete(size_t idx);
+static size_t mapped_size(size_t size);
+
+void *large_alloc(size_t size, bool zeroed)
+{
+    void *ptr;
+
+    if (size > SIZE_MAX - (size_t) sysconf(_SC_PAGESIZE))
+    {
+        return NULL;
+    }
+
+    ptr = cache_take(mapped_size(size));
+    if (ptr != NULL)
+    {
+        if (zeroed) // clearing pages that are already there is still much cheaper than faulting in new ones
+        {
+            memset(ptr, 0, size);
+        }
+    }
+    else
+    {
+        ptr = mmap(NULL, mapped_size(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            return NULL;
+        }
+    }
+
+    if (!ptrs_insert(ptr))
+    {
+        munmap(ptr, mapped_size(size));
+
+        return NULL;
+    }
+
+    return ptr;
+}
+
+bool large_free(void *ptr, size_t size)
+{
+    size_t idx;
+
+    idx = ptrs_find(ptr);
+    if (idx == SIZE_MAX)
+    {
+        return false;
+    }
+
+    ptrs_delete(idx);
+    remset_forget(ptr, size); // scanning a remembered word after its page is gone would fault
+    if (!cache_put(ptr, mapped_size(size)))
+    {
+        munmap(ptr, mapped_size(size)); // the pages go straight back to the system instead of staying with `malloc()`
+    }
+
+    return true;
+}
+
+bool large_owns(const void *ptr)
+{
+    return ptrs_find(ptr) != SIZE_MAX;
+}
+
+void *large_find(const void *ptr)
+{
+    size_t low, high, mid;
+
+    low = 0;
+    high = g_large_count;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (g_large_ptrs[mid] <= ptr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return (low > 0) ? g_large_ptrs[low - 1] : NULL;
+}
+
+void *large_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+    void *new_ptr;
+
+    if (new_size == 0)
+    {
+        large_free(ptr, old_size);
+
+        return NULL;
+    }
+
+    if (new_size > SIZE_MAX - (size_t) sysconf(_SC_PAGESIZE))
+    {
+        return NULL;
+    }
+
+    // The kernel moves the pages themselves (if it has to move them at all), so nothing is copied
+    new_ptr = mremap(ptr, mapped_size(old_size), mapped_size(new_size), MREMAP_MAYMOVE);
+    if (new_ptr == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // The chunk stays in generation 0, whose words never need remembering, so those that no longer exist are just dropped
+    remset_forget(ptr + new_size, (old_size > new_size) ? old_size - new_size : 0);
+    if (new_ptr != ptr)
+    {
+        remset_forget(ptr, (old_size < new_size) ? old_size : new_size);
+        ptrs_delete(ptrs_find(ptr));
+        ptrs_insert(new_ptr); // can't fail since a slot was just freed
+    }
+
+    return new_ptr;
+}
+
+void large_free_all(void)
+{
+    while (g_cache_count > 0)
+    {
+        g_cache_count--;
+        munmap(g_cache_ptrs[g_cache_count], g_cache_sizes[g_cache_count]);
+    }
+
+    g_cache_bytes = 0;
+
+    free(g_large_ptrs);
+    g_large_ptrs = NULL;
+    g_large_count = g_large_cap = 0;
+
+    return;
+}
+
+static void *cache_take(size_t size)
+{
+    size_t idx, best;
+    void *ptr;
+
+    // Take the smallest mapping that is large enough, and give the pages it has to spare back to the system
+    best = SIZE_MAX;
+    for (idx = 0; idx < g_cache_count; idx++)
+    {
+        if (g_cache_sizes[idx] >= size && (best == SIZE_MAX || g_cache_sizes[idx] < g_cache_sizes[best]))
+        {
+            best = idx;
+        }
+    }
+
+    if (best == SIZE_MAX)
+    {
+        return NULL;
+    }
+
+    ptr = g_cache_ptrs[best];
+    if (g_cache_sizes[best] > size)
+    {
+        munmap(ptr + size, g_cache_sizes[best] - size);
+    }
+
+    g_cache_bytes -= g_cache_sizes[best];
+    g_cache_count--;
+    g_cache_ptrs[best] = g_cache_ptrs[g_cache_count];
+    g_cache_sizes[best] = g_cache_sizes[g_cache_count];
+
+    return ptr;
+}
+
+static bool cache_put(void *ptr, size_t size)
+{
+    if (g_cache_count == LARGE_CACHE_SLOTS || size > LARGE_CACHE_BYTES - g_cache_bytes)
+    {
+        return false;
+    }
+
+    g_cache_ptrs[g_cache_count] = ptr;
+    g_cache_sizes[g_cache_count] = size;
+    g_cache_count++;
+    g_cache_bytes += size;
+
+    return true;
+}
+
+static size_t ptrs_find(const void *ptr)
+{
+    size_t low, high, mid;
+
+    // Binary search; there are few enough chunks this large that a sorted array is all it takes
+    low = 0;
+    high = g_large_count;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (g_large_ptrs[mid] == ptr)
+        {
+            return mid;
+        }
+
+        if (g_large_ptrs[mid] < ptr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+static bool ptrs_insert(void *ptr)
+{
+    size_t idx, new_cap;
+    void **p_new_ptrs;
+
+    if (g_large_count == g_large_cap)
+    {
+        new_cap = (g_large_cap == 0) ? LARGE_INITIAL_SIZE : 2 * g_large_cap;
+        p_new_ptrs = realloc(g_large_ptrs, new_cap * sizeof(void *));
+        if (p_new_ptrs == NULL)
+        {
+            return false;
+        }
+
+        g_large_ptrs = p_new_ptrs;
+        g_large_cap = new_cap;
+    }
+
+    for (idx = g_large_count; idx > 0 && g_large_ptrs[idx - 1] > ptr; idx--)
+    {
+        g_large_ptrs[idx] = g_large_ptrs[idx - 1];
+    }
+
+    g_large_ptrs[idx] = ptr;
+    g_large_count++;
+
+    return true;
+}
+
+static void ptrs_delete(size_t idx)
+{
+    memmove(g_large_ptrs + idx, g_large_ptrs + idx + 1, (g_large_count - idx - 1) * sizeof(void *));
+    g_large_count--;
+
+    return;
+}
+
+static size_t mapped_size(size_t size)
+{
+    size_t page_size;
+
+    page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    return (size + page_size - 1) / page_size * page_size;
+}
@@ -0,0 +1,35 @@
+#ifndef GCLIB_LARGE_H
+#define GCLIB_LARGE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LARGE_DEFAULT_THRESHOLD (1 << 20) // size of the smallest chunk that is mapped on its own unless `gclib_set_large_threshold()` says otherwise
+#define LARGE_INITIAL_SIZE 64
+#define LARGE_CACHE_SLOTS 16          // number of freed mappings kept for reuse at most
+#define LARGE_CACHE_BYTES (16 << 20)  // total size of the freed mappings kept for reuse at most
+
+extern size_t g_large_threshold;
+
+/* Map `size` bytes (which are zeroed if `zeroed`) for a chunk of their own, reusing a freed mapping if one is large enough. Return the chunk, or `NULL` if there wasn't enough memory. */
+void *large_alloc(size_t size, bool zeroed);
+
+/* Unmap the chunk of `size` bytes at `ptr` (or keep its mapping for reuse) if it was mapped by `large_alloc()`. Return whether it was. */
+bool large_free(void *ptr, size_t size);
+
+/* Return whether the chunk at `ptr` was mapped by `large_alloc()`. */
+bool large_owns(const void *ptr);
+
+/* Return the last chunk mapped by `large_alloc()` that starts at or below the address `ptr` (which may or may not lie within it), or `NULL` if there is none. */
+void *large_find(const void *ptr);
+
+/* Resize the chunk of `old_size` bytes at `ptr`, which was mapped by `large_alloc()`, to `new_size` bytes as `realloc()` does, keeping it mapped on its own. */
+void *large_realloc(void *ptr, size_t old_size, size_t new_size);
+
+/* Unmap the freed mappings kept for reuse and free the memory used to keep track of the mapped chunks, which must all have been unmapped already. */
+void large_free_all(void);
+
+
+#endif // GCLIB_LARGE_H
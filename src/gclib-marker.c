@@ -0,0 +1,391 @@
+#include <sched.h>
+#include <string.h>
+
+#include "gclib-marker.h"
+
+unsigned int g_marker_threads = 1; // number of threads that mark during a collection, including the collecting thread
+
+static marker g_markers[MARKER_MAX_THREADS];                     // `g_markers[0]` is the collecting thread and the rest are helpers
+static unsigned int g_marker_idle;                               // number of markers that have run out of work in the current round
+static unsigned long g_marker_round;                             // incremented to wake the helpers up for each collection
+static unsigned int g_marker_finished;                           // number of helpers done with the current round
+static bool g_marker_exit;                                       // tells the helpers to exit instead of waiting for another round
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;  // protects the four variables above
+static pthread_cond_t g_pool_wake = PTHREAD_COND_INITIALIZER;    // signaled when a round starts or the helpers should exit
+static pthread_cond_t g_pool_done = PTHREAD_COND_INITIALIZER;    // signaled when a helper finishes its round
+
+bool g_mark_background; // whether the background thread is still marking for the current collection
+
+static pthread_t g_background_thread;
+static bool g_background_started;                                      // whether `g_background_thread` is running
+static mark_stack *g_background_stack;                                 // stack the background thread is working through, or `NULL` while it waits for work
+static bool g_background_stop;                                         // tells the background thread to leave the rest of its stack alone
+static bool g_background_exit;                                         // tells the background thread to exit instead of waiting for more work
+static pthread_mutex_t g_background_lock = PTHREAD_MUTEX_INITIALIZER;  // protects `g_background_stack` and `g_background_exit`
+static pthread_cond_t g_background_wake = PTHREAD_COND_INITIALIZER;    // signaled when there is work or the background thread should exit
+static pthread_cond_t g_background_done = PTHREAD_COND_INITIALIZER;    // signaled when the background thread is done with its stack
+
+static void *helper_main(void *p_arg);
+static void *background_main(void *p_arg);
+static void marker_work(marker *p_self);
+static bool marker_steal(marker *p_self);
+static void marker_share(marker *p_self);
+
+bool marker_start(unsigned int threads)
+{
+    unsigned int i;
+
+    marker_stop();
+
+    if (threads > MARKER_MAX_THREADS)
+    {
+        threads = MARKER_MAX_THREADS;
+    }
+
+    g_marker_exit = false;
+    pthread_mutex_init(&g_markers[0].lock, NULL);
+
+    for (i = 1; i < threads; i++)
+    {
+        pthread_mutex_init(&g_markers[i].lock, NULL);
+        g_markers[i].round = g_marker_round; // the helper may not get to run before the next round starts
+        if (pthread_create(&g_markers[i].thread, NULL, helper_main, &g_markers[i]) != 0)
+        {
+            marker_stop(); // the helpers created so far
+
+            return false;
+        }
+
+        g_marker_threads = i + 1;
+    }
+
+    return true;
+}
+
+void marker_stop(void)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&g_pool_lock);
+    g_marker_exit = true;
+    pthread_cond_broadcast(&g_pool_wake);
+    pthread_mutex_unlock(&g_pool_lock);
+
+    for (i = 0; i < g_marker_threads; i++)
+    {
+        if (i > 0)
+        {
+            pthread_join(g_markers[i].thread, NULL);
+        }
+
+        collector_free_stack(&g_markers[i].local);
+        collector_free_stack(&g_markers[i].shared);
+    }
+
+    g_marker_threads = 1;
+
+    return;
+}
+
+void marker_run(mark_stack *p_roots)
+{
+    size_t i, next, slice;
+    const void **start;
+    mark_range range;
+
+    // Deal the roots out in slices so that even a single large root range (such as the BSS) is split between markers.
+    // They go onto the shared stacks since nobody has to hand anything off to get the others started.
+    next = 0;
+    for (i = 0; i < p_roots->len; i++)
+    {
+        range = p_roots->p_ranges[i];
+        slice = collector_slice_words(range.p_layout);
+        for (start = range.start; start < range.end; start += slice)
+        {
+            collector_push_root(&g_markers[next].shared, start, ((size_t) (range.end - start) > slice) ? start + slice : range.end, range.gen, range.p_layout);
+            next = (next + 1) % g_marker_threads;
+        }
+    }
+    p_roots->len = 0;
+
+    g_marker_idle = 0;
+    g_mark_parallel = true;
+
+    pthread_mutex_lock(&g_pool_lock);
+    g_marker_finished = 0;
+    g_marker_round++;
+    pthread_cond_broadcast(&g_pool_wake);
+    pthread_mutex_unlock(&g_pool_lock);
+
+    marker_work(&g_markers[0]);
+
+    pthread_mutex_lock(&g_pool_lock);
+    while (g_marker_finished < g_marker_threads - 1)
+    {
+        pthread_cond_wait(&g_pool_done, &g_pool_lock);
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+
+    g_mark_parallel = false;
+
+    // A marker that couldn't grow its stack to steal a range went idle and left it behind
+    for (i = 0; i < g_marker_threads; i++)
+    {
+        collector_drain(&g_markers[i].shared);
+    }
+
+    return;
+}
+
+bool marker_background_start(void)
+{
+    if (g_background_started)
+    {
+        return true;
+    }
+
+    g_background_exit = false;
+    g_background_started = pthread_create(&g_background_thread, NULL, background_main, NULL) == 0;
+
+    return g_background_started;
+}
+
+void marker_background_stop(void)
+{
+    marker_background_wait(true);
+
+    if (!g_background_started)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_background_lock);
+    g_background_exit = true;
+    pthread_cond_signal(&g_background_wake);
+    pthread_mutex_unlock(&g_background_lock);
+
+    pthread_join(g_background_thread, NULL);
+    g_background_started = false;
+
+    return;
+}
+
+void marker_background_run(mark_stack *p_stack)
+{
+    __atomic_store_n(&g_background_stop, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_mark_background, true, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&g_background_lock);
+    g_background_stack = p_stack;
+    pthread_cond_signal(&g_background_wake);
+    pthread_mutex_unlock(&g_background_lock);
+
+    return;
+}
+
+void marker_background_wait(bool abandon)
+{
+    if (abandon)
+    {
+        __atomic_store_n(&g_background_stop, true, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&g_background_lock);
+    while (g_background_stack != NULL)
+    {
+        pthread_cond_wait(&g_background_done, &g_background_lock);
+    }
+    pthread_mutex_unlock(&g_background_lock);
+
+    __atomic_store_n(&g_mark_background, false, __ATOMIC_RELAXED); // in case the thread was stopped before it got to the stack
+
+    return;
+}
+
+static void *helper_main(void *p_arg)
+{
+    marker *p_self;
+
+    p_self = p_arg;
+
+    pthread_mutex_lock(&g_pool_lock);
+    while (true)
+    {
+        while (g_marker_round == p_self->round && !g_marker_exit)
+        {
+            pthread_cond_wait(&g_pool_wake, &g_pool_lock);
+        }
+
+        if (g_marker_exit)
+        {
+            break;
+        }
+
+        p_self->round = g_marker_round;
+        pthread_mutex_unlock(&g_pool_lock);
+
+        marker_work(p_self);
+
+        pthread_mutex_lock(&g_pool_lock);
+        g_marker_finished++;
+        pthread_cond_signal(&g_pool_done);
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+
+    return NULL;
+}
+
+static void *background_main(void *p_arg)
+{
+    mark_stack *p_stack;
+
+    (void) p_arg;
+
+    pthread_mutex_lock(&g_background_lock);
+    while (true)
+    {
+        while (g_background_stack == NULL && !g_background_exit)
+        {
+            pthread_cond_wait(&g_background_wake, &g_background_lock);
+        }
+
+        if (g_background_exit)
+        {
+            break;
+        }
+
+        p_stack = g_background_stack;
+        pthread_mutex_unlock(&g_background_lock);
+
+        // The program may create slab pages in the meantime, which moves the others around in `g_slab_pages`. Holding
+        // on to them for a slice at a time keeps that rare case from slowing down the lookups.
+        while (p_stack->len > 0 && !__atomic_load_n(&g_background_stop, __ATOMIC_RELAXED))
+        {
+            slab_lock_pages();
+            collector_scan_next(p_stack);
+            slab_unlock_pages();
+        }
+
+        pthread_mutex_lock(&g_background_lock);
+        g_background_stack = NULL;
+        __atomic_store_n(&g_mark_background, false, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&g_background_done);
+    }
+    pthread_mutex_unlock(&g_background_lock);
+
+    return NULL;
+}
+
+static void marker_work(marker *p_self)
+{
+    while (true)
+    {
+        while (p_self->local.len > 0)
+        {
+            collector_scan_next(&p_self->local);
+
+            if (p_self->local.len > MARKER_SHARE_THRESHOLD && __atomic_load_n(&g_marker_idle, __ATOMIC_RELAXED) > 0)
+            {
+                marker_share(p_self);
+            }
+        }
+
+        if (marker_steal(p_self))
+        {
+            continue;
+        }
+
+        // Out of work, so wait for another marker to share some. Markers only become idle with both of their stacks
+        // empty (unless their local stack couldn't grow), so once all of them are idle there is nothing left to do.
+        __atomic_add_fetch(&g_marker_idle, 1, __ATOMIC_ACQ_REL);
+        while (true)
+        {
+            if (__atomic_load_n(&g_marker_idle, __ATOMIC_ACQUIRE) == g_marker_threads)
+            {
+                return;
+            }
+
+            if (marker_steal(p_self))
+            {
+                __atomic_sub_fetch(&g_marker_idle, 1, __ATOMIC_ACQ_REL);
+
+                break;
+            }
+
+            sched_yield();
+        }
+    }
+}
+
+static bool marker_steal(marker *p_self)
+{
+    unsigned int i, self;
+    size_t take;
+    mark_range range;
+    marker *p_victim;
+
+    // Start with our own shared stack so that nothing is left on it when we go idle
+    self = p_self - g_markers;
+    for (i = 0; i < g_marker_threads; i++)
+    {
+        p_victim = &g_markers[(self + i) % g_marker_threads];
+        if (__atomic_load_n(&p_victim->shared.len, __ATOMIC_RELAXED) == 0)
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&p_victim->lock);
+
+        // Take half of the victim's shared ranges (or all of them if they're our own). Those that don't fit on our
+        // stack are left where they are, since the victim's stack may hold roots, which would be lost.
+        take = (p_victim == p_self) ? p_victim->shared.len : (p_victim->shared.len + 1) / 2;
+        while (take-- > 0)
+        {
+            range = p_victim->shared.p_ranges[p_victim->shared.len - 1];
+            if (!collector_push(&p_self->local, range.start, range.end, range.gen, range.p_layout))
+            {
+                break;
+            }
+
+            p_victim->shared.len--;
+        }
+
+        pthread_mutex_unlock(&p_victim->lock);
+
+        if (p_self->local.len > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void marker_share(marker *p_self)
+{
+    size_t give, i;
+    mark_range range;
+
+    pthread_mutex_lock(&p_self->lock);
+
+    // Hand off the oldest half of our ranges, which tend to lead to the most unexplored parts of the heap
+    if (p_self->shared.len == 0)
+    {
+        give = p_self->local.len / 2;
+        for (i = 0; i < give; i++)
+        {
+            range = p_self->local.p_ranges[i];
+            if (!collector_push(&p_self->shared, range.start, range.end, range.gen, range.p_layout)) // keep the rest
+            {
+                give = i;
+            }
+        }
+
+        memmove(p_self->local.p_ranges, p_self->local.p_ranges + give, (p_self->local.len - give) * sizeof(mark_range));
+        p_self->local.len -= give;
+    }
+
+    pthread_mutex_unlock(&p_self->lock);
+
+    return;
+}
@@ -0,0 +1,49 @@
+#ifndef GCLIB_MARKER_H
+#define GCLIB_MARKER_H
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gclib-collector.h"
+
+#define MARKER_MAX_THREADS 64
+#define MARKER_SHARE_THRESHOLD 32 // number of ranges a marker must have before it hands some off to idle markers
+
+/* A thread taking part in the mark phase, along with the work it has yet to do. */
+typedef struct marker
+{
+    pthread_t thread;
+    mark_stack local;        // ranges only this marker scans
+    mark_stack shared;       // ranges other markers may steal
+    pthread_mutex_t lock;    // protects `shared`
+    unsigned long round;     // last round of marking the helper took part in
+} marker;
+
+extern unsigned int g_marker_threads;
+extern bool g_mark_background;
+
+/* Start the pool of helper threads so that marking is split between `threads` threads (including the collecting thread). Return `false` if the pool couldn't be started, in which case marking happens on the collecting thread alone. */
+bool marker_start(unsigned int threads);
+
+/* Stop and join the helper threads, after which marking happens on the collecting thread alone. */
+void marker_stop(void);
+
+/* Mark everything reachable from the ranges on `*p_roots` using every thread in the pool, leaving `*p_roots` empty. */
+void marker_run(mark_stack *p_roots);
+
+/* Start the thread that marks while the program keeps running during concurrent collections. Return `false` if it couldn't be started. */
+bool marker_background_start(void);
+
+/* Stop and join the background thread, leaving whatever it hadn't marked yet on its stack. */
+void marker_background_stop(void);
+
+/* Have the background thread mark everything reachable from the ranges on `*p_stack`, clearing `g_mark_background` once it is done. */
+void marker_background_run(mark_stack *p_stack);
+
+/* Wait for the background thread to be done with its stack, or with `abandon` set, have it stop early and leave the rest on the stack. */
+void marker_background_wait(bool abandon);
+
+
+#endif // GCLIB_MARKER_H
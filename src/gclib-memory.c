@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gclib-memory.h"
+
+static int g_statm_fd = -1; // /proc/self/statm, whose second field is the number of resident pages
+
+static size_t limit_read(const char *path);
+
+size_t memory_cgroup_limit(void)
+{
+    char line[4096], path[4200], *p_path;
+    size_t limit;
+    FILE *p_file;
+
+    // The cgroup the process belongs to is listed in /proc/self/cgroup as "0::PATH" for v2 and "ID:memory:PATH" for
+    // the v1 memory controller. Containers usually mount their own cgroup at the root instead, so try that last.
+    limit = 0;
+    p_file = fopen("/proc/self/cgroup", "r");
+    while (p_file != NULL && limit == 0 && fgets(line, sizeof(line), p_file) != NULL)
+    {
+        line[strcspn(line, "\n")] = '\0';
+        p_path = strchr(line, ':');
+        if (p_path == NULL)
+        {
+            continue;
+        }
+
+        if (strncmp(p_path, "::", 2) == 0)
+        {
+            snprintf(path, sizeof(path), "/sys/fs/cgroup%s/memory.max", p_path + 2);
+            limit = limit_read(path);
+        }
+        else if (strncmp(p_path, ":memory:", 8) == 0)
+        {
+            snprintf(path, sizeof(path), "/sys/fs/cgroup/memory%s/memory.limit_in_bytes", p_path + 8);
+            limit = limit_read(path);
+        }
+    }
+
+    if (p_file != NULL)
+    {
+        fclose(p_file);
+    }
+
+    if (limit == 0)
+    {
+        limit = limit_read("/sys/fs/cgroup/memory.max");
+    }
+
+    if (limit == 0)
+    {
+        limit = limit_read("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+    }
+
+    return limit;
+}
+
+size_t memory_rss(void)
+{
+    char buffer[128], *p_field;
+    ssize_t bytes;
+
+    if (g_statm_fd < 0)
+    {
+        g_statm_fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+        if (g_statm_fd < 0)
+        {
+            return 0;
+        }
+    }
+
+    // Read with `pread()` rather than `stdio` since this is done after every collection
+    bytes = pread(g_statm_fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytes <= 0)
+    {
+        return 0;
+    }
+
+    buffer[bytes] = '\0';
+    p_field = strchr(buffer, ' ');
+    if (p_field == NULL)
+    {
+        return 0;
+    }
+
+    return strtoull(p_field + 1, NULL, 10) * sysconf(_SC_PAGESIZE);
+}
+
+void memory_release(void)
+{
+    // Besides shrinking the top of the heap, glibc gives back every whole page of free memory within it (and within
+    // the other arenas) with `madvise(MADV_DONTNEED)`
+    malloc_trim(0);
+
+    return;
+}
+
+void memory_free(void)
+{
+    if (g_statm_fd >= 0)
+    {
+        close(g_statm_fd);
+    }
+
+    g_statm_fd = -1;
+
+    return;
+}
+
+static size_t limit_read(const char *path)
+{
+    unsigned long long limit;
+    FILE *p_file;
+
+    p_file = fopen(path, "r");
+    if (p_file == NULL)
+    {
+        return 0;
+    }
+
+    if (fscanf(p_file, "%llu", &limit) != 1) // "max" when there is no limit
+    {
+        limit = 0;
+    }
+
+    fclose(p_file);
+
+    return (limit >= MEMORY_UNLIMITED) ? 0 : limit;
+}
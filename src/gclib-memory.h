@@ -0,0 +1,26 @@
+#ifndef GCLIB_MEMORY_H
+#define GCLIB_MEMORY_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MEMORY_UNLIMITED ((size_t) 1 << 62) // cgroup limits at or above this many bytes are taken to mean that there is none
+#define MEMORY_CGROUP_PERCENT 90            // percentage of the cgroup's memory limit that the heap limit defaults to
+#define MEMORY_RELEASE_BYTES (64 << 20)     // number of bytes that have to be freed since memory was last given back to the system before it is again
+
+/* Return the memory limit (in bytes) of the cgroup the process belongs to, or 0 if it has none or it can't be found. Both cgroup v2 (`memory.max`) and v1 (`memory.limit_in_bytes`) are looked for. */
+size_t memory_cgroup_limit(void);
+
+/* Return the resident set size of the process in bytes, or 0 if it can't be found. */
+size_t memory_rss(void);
+
+/* Give the free memory at the top of the heap and the whole pages of free memory within it back to the system. */
+void memory_release(void);
+
+/* Close the files used to measure the process. */
+void memory_free(void);
+
+
+#endif // GCLIB_MEMORY_H
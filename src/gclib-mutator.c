@@ -0,0 +1,234 @@
+#define _GNU_SOURCE // for `pthread_getattr_np()` and `REG_RSP`
+
+#include <errno.h>
+#include <semaphore.h>
+#include <string.h>
+
+#include "gclib-mutator.h"
+
+mutator *g_mutators;              // linked list of every registered thread
+__thread mutator *g_mutator_self; // the calling thread's entry in `g_mutators`, or `NULL` if it isn't registered
+
+static sem_t g_mutator_ack;                   // posted by each signaled thread once it has stopped and again once it has resumed
+static volatile sig_atomic_t g_world_stopped; // whether stopped threads have to stay in their signal handler
+
+static void suspend_handler(int sig, siginfo_t *p_info, void *p_context);
+static void resume_handler(int sig);
+static void wait_acks(unsigned int count);
+
+bool mutator_init(void)
+{
+    struct sigaction action;
+
+    if (sem_init(&g_mutator_ack, 0, 0) != 0)
+    {
+        return false;
+    }
+
+    memset(&action, 0, sizeof(struct sigaction));
+    sigfillset(&action.sa_mask); // the only signal a stopped thread may handle is the one resuming it, which `sigsuspend()` lets through
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    action.sa_sigaction = suspend_handler;
+    if (sigaction(MUTATOR_SUSPEND_SIGNAL, &action, NULL) != 0)
+    {
+        return false;
+    }
+
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = resume_handler;
+    if (sigaction(MUTATOR_RESUME_SIGNAL, &action, NULL) != 0)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+mutator *mutator_register(const void **stack_base)
+{
+    void *stack_addr;
+    size_t stack_size;
+    sigset_t mask;
+    pthread_attr_t attr;
+    mutator *p_mutator;
+
+    if (g_mutator_self != NULL)
+    {
+        return g_mutator_self;
+    }
+
+    p_mutator = calloc(1, sizeof(mutator));
+    if (p_mutator == NULL)
+    {
+        return NULL;
+    }
+
+    if (stack_base == NULL) // scan the whole stack of the thread since there's no knowing which of its frames hold references
+    {
+        if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        {
+            free(p_mutator);
+
+            return NULL;
+        }
+
+        pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+        pthread_attr_destroy(&attr);
+        stack_base = stack_addr + stack_size;
+    }
+
+    // A thread that can't be stopped would hang every collection
+    sigemptyset(&mask);
+    sigaddset(&mask, MUTATOR_SUSPEND_SIGNAL);
+    pthread_sigmask(SIG_UNBLOCK, &mask, NULL);
+
+    p_mutator->thread = pthread_self();
+    p_mutator->stack_base = stack_base;
+    p_mutator->next = g_mutators;
+    g_mutators = p_mutator;
+    g_mutator_self = p_mutator;
+
+    return p_mutator;
+}
+
+void mutator_unregister(void)
+{
+    uint8_t size_class;
+    mutator **pp_current;
+
+    if (g_mutator_self == NULL)
+    {
+        return;
+    }
+
+    for (size_class = 0; size_class < SLAB_CLASSES; size_class++)
+    {
+        slab_tlab_retire(&g_mutator_self->p_tlabs[false][size_class]);
+        slab_tlab_retire(&g_mutator_self->p_tlabs[true][size_class]);
+    }
+
+    for (pp_current = &g_mutators; *pp_current != g_mutator_self; pp_current = &(*pp_current)->next)
+        ;
+
+    *pp_current = g_mutator_self->next;
+    free(g_mutator_self);
+    g_mutator_self = NULL;
+
+    return;
+}
+
+void mutator_stop_world(void)
+{
+    unsigned int count;
+    mutator *p_mutator;
+
+    g_world_stopped = true;
+
+    count = 0;
+    for (p_mutator = g_mutators; p_mutator != NULL; p_mutator = p_mutator->next)
+    {
+        p_mutator->stopped = p_mutator != g_mutator_self && pthread_kill(p_mutator->thread, MUTATOR_SUSPEND_SIGNAL) == 0; // fails only if the thread exited without unregistering
+        if (p_mutator->stopped)
+        {
+            count++;
+        }
+    }
+
+    wait_acks(count);
+
+    return;
+}
+
+void mutator_start_world(void)
+{
+    unsigned int count;
+    mutator *p_mutator;
+
+    g_world_stopped = false;
+
+    count = 0;
+    for (p_mutator = g_mutators; p_mutator != NULL; p_mutator = p_mutator->next)
+    {
+        if (p_mutator->stopped && pthread_kill(p_mutator->thread, MUTATOR_RESUME_SIGNAL) == 0)
+        {
+            count++;
+        }
+
+        p_mutator->stopped = false;
+    }
+
+    wait_acks(count); // so that none of them can still be in its handler when the next collection stops them again
+
+    return;
+}
+
+void mutator_free(void)
+{
+    mutator *p_current, *p_tmp;
+
+    p_current = g_mutators;
+    while (p_current != NULL)
+    {
+        p_tmp = p_current;
+        p_current = p_current->next;
+        free(p_tmp);
+    }
+
+    g_mutators = NULL;
+    g_mutator_self = NULL;
+    sem_destroy(&g_mutator_ack);
+
+    return;
+}
+
+static void suspend_handler(int sig, siginfo_t *p_info, void *p_context)
+{
+    int saved_errno;
+    sigset_t mask;
+    ucontext_t *p_ucontext;
+
+    (void) sig;
+    (void) p_info;
+
+    saved_errno = errno;
+    p_ucontext = p_context;
+
+    // The kernel saved the registers of the interrupted code, which may hold the only references to some chunks.
+    // Anything below the stack pointer other than the red zone is dead.
+    memcpy(g_mutator_self->regs, p_ucontext->uc_mcontext.gregs, sizeof(gregset_t));
+    g_mutator_self->stack_top = (const void **) (p_ucontext->uc_mcontext.gregs[REG_RSP] - MUTATOR_RED_ZONE);
+    sem_post(&g_mutator_ack);
+
+    // The resume signal is blocked until `sigsuspend()` is reached, so it can't be missed
+    sigfillset(&mask);
+    sigdelset(&mask, MUTATOR_RESUME_SIGNAL);
+    while (g_world_stopped)
+    {
+        sigsuspend(&mask);
+    }
+
+    sem_post(&g_mutator_ack);
+    errno = saved_errno;
+
+    return;
+}
+
+static void resume_handler(int sig)
+{
+    (void) sig; // only needs to interrupt `sigsuspend()`
+
+    return;
+}
+
+static void wait_acks(unsigned int count)
+{
+    while (count > 0)
+    {
+        if (sem_wait(&g_mutator_ack) == 0) // otherwise interrupted by a signal
+        {
+            count--;
+        }
+    }
+
+    return;
+}
@@ -0,0 +1,52 @@
+#ifndef GCLIB_MUTATOR_H
+#define GCLIB_MUTATOR_H
+
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <ucontext.h>
+
+#include "gclib-remset.h"
+#include "gclib-slab.h"
+
+#define MUTATOR_SUSPEND_SIGNAL SIGPWR  // sent to each registered thread to stop it for a collection
+#define MUTATOR_RESUME_SIGNAL SIGXCPU  // sent to each stopped thread once the collection no longer needs it stopped
+#define MUTATOR_RED_ZONE 128           // bytes below the stack pointer that a function may use without moving it (x86-64 System V ABI)
+
+/* A thread registered with `gclib` whose stack and registers are scanned by every collection. */
+typedef struct mutator
+{
+    pthread_t thread;
+    const void **stack_base;              // end of the part of the thread's stack that is scanned (stacks grow down)
+    const void **stack_top;               // lowest address in use on the thread's stack when it was last stopped
+    gregset_t regs;                       // the thread's registers when it was last stopped
+    bool stopped;                         // whether the thread is waiting in its signal handler for the world to be started again
+    slab_page *p_tlabs[2][SLAB_CLASSES];  // page that each size class (of scanned and atomic objects) is allocated from without taking `g_gclib_lock`
+    remset_buffer barrier;                // words stored to through `gclib_write_ptr()` without taking `g_gclib_lock`
+    struct mutator *next;
+} mutator;
+
+extern mutator *g_mutators;
+extern __thread mutator *g_mutator_self;
+
+/* Install the signal handlers used to stop and resume registered threads. Return whether that succeeded. */
+bool mutator_init(void);
+
+/* Register the calling thread, whose stack is scanned up to `stack_base` (or up to where its stack ends if `NULL`). Return its `mutator`, or `NULL` if there wasn't enough memory to register it. */
+mutator *mutator_register(const void **stack_base);
+
+/* Unregister the calling thread, returning the unused objects of its allocation buffers. */
+void mutator_unregister(void);
+
+/* Stop every registered thread other than the calling one and capture its stack pointer and registers. */
+void mutator_stop_world(void);
+
+/* Resume the threads stopped by `mutator_stop_world()`. */
+void mutator_start_world(void);
+
+/* Unregister every thread and free the memory used to keep track of them. */
+void mutator_free(void);
+
+
+#endif // GCLIB_MUTATOR_H
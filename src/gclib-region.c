@@ -0,0 +1,190 @@
+#include "gclib-region.h"
+
+#define REGION_HEADER_SIZE ((sizeof(region_block) + REGION_ALIGN - 1) & ~(size_t) (REGION_ALIGN - 1)) // offset of the memory of a block from its header
+
+static gclib_region *g_regions; // every region that hasn't been destroyed yet
+
+static void *block_data(region_block *p_block);
+static size_t align_size(size_t size);
+
+gclib_region *region_create(bool scanned)
+{
+    gclib_region *p_region;
+
+    p_region = malloc(sizeof(gclib_region));
+    if (p_region == NULL)
+    {
+        return NULL;
+    }
+
+    p_region->p_blocks = NULL; // the first block is only made once something is allocated
+    p_region->scanned = scanned;
+    p_region->p_prev = NULL;
+    p_region->p_next = g_regions;
+    if (p_region->p_next != NULL)
+    {
+        p_region->p_next->p_prev = p_region;
+    }
+
+    g_regions = p_region;
+
+    return p_region;
+}
+
+void *region_alloc(gclib_region *p_region, size_t size)
+{
+    void *ptr;
+    region_block *p_block;
+
+    p_block = p_region->p_blocks;
+    if (p_block == NULL || size > p_block->size - p_block->used)
+    {
+        return NULL;
+    }
+
+    size = align_size(size);
+    if (size > p_block->size - p_block->used)
+    {
+        return NULL;
+    }
+
+    // Only the memory before `used` is scanned, which the program can't have stored anything into until this returns.
+    // A collection that stops the thread before `used` is updated never looks at the allocation at all.
+    ptr = block_data(p_block) + p_block->used;
+    p_block->used += size;
+
+    return ptr;
+}
+
+void *region_refill(gclib_region *p_region, size_t size)
+{
+    size_t block_size;
+    region_block *p_block;
+
+    if (size > SIZE_MAX - REGION_HEADER_SIZE - REGION_ALIGN)
+    {
+        return NULL;
+    }
+
+    // An allocation that would waste much of a new block gets one of its own, after which the current block is still
+    // allocated from
+    size = align_size(size);
+    block_size = (size > REGION_BLOCK_SIZE / 4) ? size : REGION_BLOCK_SIZE;
+    p_block = malloc(REGION_HEADER_SIZE + block_size);
+    if (p_block == NULL)
+    {
+        return NULL;
+    }
+
+    p_block->size = block_size;
+    p_block->used = size;
+    if (block_size == size && p_region->p_blocks != NULL)
+    {
+        p_block->p_next = p_region->p_blocks->p_next;
+        p_region->p_blocks->p_next = p_block;
+    }
+    else
+    {
+        p_block->p_next = p_region->p_blocks;
+        p_region->p_blocks = p_block;
+    }
+
+    return block_data(p_block);
+}
+
+void region_unlink(gclib_region *p_region)
+{
+    if (p_region->p_prev != NULL)
+    {
+        p_region->p_prev->p_next = p_region->p_next;
+    }
+    else if (g_regions == p_region)
+    {
+        g_regions = p_region->p_next;
+    }
+
+    if (p_region->p_next != NULL)
+    {
+        p_region->p_next->p_prev = p_region->p_prev;
+    }
+
+    p_region->p_prev = p_region->p_next = NULL;
+
+    return;
+}
+
+void region_forget(gclib_region *p_region)
+{
+    region_block *p_block;
+
+    for (p_block = p_region->p_blocks; p_block != NULL; p_block = p_block->p_next)
+    {
+        remset_forget(block_data(p_block), p_block->size); // scanning a remembered word after its block is freed would fault
+    }
+
+    return;
+}
+
+void region_free(gclib_region *p_region)
+{
+    region_block *p_block, *p_next;
+
+    for (p_block = p_region->p_blocks; p_block != NULL; p_block = p_next)
+    {
+        p_next = p_block->p_next;
+        free(p_block);
+    }
+
+    free(p_region);
+
+    return;
+}
+
+size_t region_push(mark_stack *p_stack)
+{
+    size_t words;
+    gclib_region *p_region;
+    region_block *p_block;
+
+    words = 0;
+    for (p_region = g_regions; p_region != NULL; p_region = p_region->p_next)
+    {
+        if (!p_region->scanned)
+        {
+            continue;
+        }
+
+        for (p_block = p_region->p_blocks; p_block != NULL; p_block = p_block->p_next)
+        {
+            collector_push_root(p_stack, block_data(p_block), block_data(p_block) + p_block->used, MARK_UNTRACKED, NULL);
+            words += p_block->used / sizeof(void *);
+        }
+    }
+
+    return words;
+}
+
+void region_free_all(void)
+{
+    gclib_region *p_region, *p_next;
+
+    for (p_region = g_regions; p_region != NULL; p_region = p_next)
+    {
+        p_next = p_region->p_next;
+        p_region->p_prev = p_region->p_next = NULL;
+    }
+
+    g_regions = NULL;
+
+    return;
+}
+
+static void *block_data(region_block *p_block)
+{
+    return (void *) p_block + REGION_HEADER_SIZE;
+}
+
+static size_t align_size(size_t size)
+{
+    return (size + REGION_ALIGN - 1) & ~(size_t) (REGION_ALIGN - 1);
+}
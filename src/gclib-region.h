@@ -0,0 +1,52 @@
+#ifndef GCLIB_REGION_H
+#define GCLIB_REGION_H
+
+
+#include "gclib-collector.h"
+
+#define REGION_BLOCK_SIZE 65536 // number of bytes in each block of a region, other than those for larger allocations
+#define REGION_ALIGN 16         // alignment of every allocation from a region, which is the same as that of `malloc()`
+
+/* A block of memory that a region hands out allocations from one after the other, which follows this header. */
+typedef struct region_block
+{
+    struct region_block *p_next;
+    size_t size; // number of bytes in the block
+    size_t used; // number of those bytes handed out so far
+} region_block;
+
+/* A region handed out by `gclib_region_create()`. */
+struct gclib_region
+{
+    region_block *p_blocks; // the block allocations are taken from first, followed by those that are full (or were made for a single larger allocation)
+    bool scanned;           // whether collections scan the memory allocated from the region
+    gclib_region *p_prev;
+    gclib_region *p_next;   // the other live regions, linked from `g_regions`
+};
+
+/* Return a new region, which collections scan if `scanned`, or `NULL` if there wasn't enough memory. */
+gclib_region *region_create(bool scanned);
+
+/* Allocate `size` bytes (which must be nonzero) from the current block of `*p_region`. Return the allocation, or `NULL` if the block doesn't have room for it. Only the thread that allocates from the region may call this, which needs no lock. */
+void *region_alloc(gclib_region *p_region, size_t size);
+
+/* Give `*p_region` a new block with room for `size` bytes and allocate them from it. Return the allocation, or `NULL` if there wasn't enough memory. */
+void *region_refill(gclib_region *p_region, size_t size);
+
+/* Stop collections from scanning the memory of `*p_region`, which is about to be freed. */
+void region_unlink(gclib_region *p_region);
+
+/* Drop the words of the memory allocated from `*p_region` from the remembered set, which must already hold every word remembered so far. */
+void region_forget(gclib_region *p_region);
+
+/* Free every block of `*p_region` along with the region itself. */
+void region_free(gclib_region *p_region);
+
+/* Scan the memory allocated from every scanned region onto `*p_stack` as roots. Return the number of words scanned. */
+size_t region_push(mark_stack *p_stack);
+
+/* Unlink every region, leaving their memory to the program. */
+void region_free_all(void);
+
+
+#endif // GCLIB_REGION_H
@@ -0,0 +1,296 @@
+#include <sys/mman.h>
+
+#include "gclib-remset.h"
+
+remset_card *g_remset;   // open-addressing hash table of dirty cards
+size_t g_remset_cap;     // number of slots in `g_remset` (always a power of two)
+size_t g_remset_count;   // number of dirty cards in `g_remset`
+bool g_remset_overflow;  // set when a word couldn't be remembered because `g_remset` couldn't grow
+
+static size_t card_hash(uintptr_t card, size_t cap);
+static remset_card *card_find(uintptr_t card);
+static remset_card *card_insert(uintptr_t card);
+static bool remset_grow(void);
+static remset_card *cards_alloc(size_t cap);
+static void cards_free(remset_card *p_cards, size_t cap);
+
+void remset_add(const void *ptr)
+{
+    remset_card *p_card;
+
+    p_card = card_insert((uintptr_t) ptr >> CARD_SHIFT);
+    if (p_card == NULL) // only collections that trace every generation are sound from here on
+    {
+        g_remset_overflow = true;
+
+        return;
+    }
+
+    p_card->words |= UINT64_C(1) << (((uintptr_t) ptr >> 3) % CARD_WORDS);
+
+    return;
+}
+
+void remset_add_range(const void *ptr, size_t size)
+{
+    uintptr_t card, first, last;
+    size_t first_word, last_word;
+    remset_card *p_card;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    first = (uintptr_t) ptr >> CARD_SHIFT;
+    last = ((uintptr_t) ptr + size - 1) >> CARD_SHIFT;
+
+    for (card = first; card <= last; card++)
+    {
+        p_card = card_insert(card);
+        if (p_card == NULL)
+        {
+            g_remset_overflow = true;
+
+            return;
+        }
+
+        first_word = (card == first) ? ((uintptr_t) ptr >> 3) % CARD_WORDS : 0;
+        last_word = (card == last) ? (((uintptr_t) ptr + size - 1) >> 3) % CARD_WORDS : CARD_WORDS - 1;
+        p_card->words |= (~UINT64_C(0) >> (CARD_WORDS - 1 - last_word)) & (~UINT64_C(0) << first_word);
+    }
+
+    return;
+}
+
+void remset_forget(const void *ptr, size_t size)
+{
+    uintptr_t card, first, last;
+    size_t first_word, last_word;
+    uint64_t mask;
+    remset_card *p_card;
+
+    if (g_remset_count == 0 || size == 0)
+    {
+        return;
+    }
+
+    first = (uintptr_t) ptr >> CARD_SHIFT;
+    last = ((uintptr_t) ptr + size - 1) >> CARD_SHIFT;
+
+    for (card = first; card <= last; card++)
+    {
+        p_card = card_find(card);
+        if (p_card == NULL)
+        {
+            continue;
+        }
+
+        // Only clear the words belonging to the freed memory since neighbouring chunks may share the card
+        first_word = (card == first) ? ((uintptr_t) ptr >> 3) % CARD_WORDS : 0;
+        last_word = (card == last) ? (((uintptr_t) ptr + size - 1) >> 3) % CARD_WORDS : CARD_WORDS - 1;
+        mask = (~UINT64_C(0) >> (CARD_WORDS - 1 - last_word)) & (~UINT64_C(0) << first_word);
+
+        p_card->words &= ~mask; // emptied cards stay in the table until the next `remset_compact()`
+    }
+
+    return;
+}
+
+void remset_move(const void *ptr, const void *new_ptr, size_t size)
+{
+    uintptr_t card, first, last;
+    uint64_t words;
+    uint8_t word;
+    const void *p_word;
+    remset_card *p_card;
+
+    if (g_remset_count == 0 || size == 0)
+    {
+        return;
+    }
+
+    first = (uintptr_t) ptr >> CARD_SHIFT;
+    last = ((uintptr_t) ptr + size - 1) >> CARD_SHIFT;
+
+    for (card = first; card <= last; card++)
+    {
+        p_card = card_find(card);
+        if (p_card == NULL)
+        {
+            continue;
+        }
+
+        words = p_card->words; // `remset_add()` may grow the table and move the card
+        for (word = 0; word < CARD_WORDS; word++)
+        {
+            p_word = (const void *) ((card << CARD_SHIFT) + word * sizeof(void *));
+            if ((words & (UINT64_C(1) << word)) && ptr <= p_word && p_word < ptr + size)
+            {
+                remset_add(new_ptr + (p_word - ptr));
+            }
+        }
+    }
+
+    return;
+}
+
+void remset_compact(void)
+{
+    size_t idx, new_idx, old_cap;
+    remset_card *p_old;
+
+    if (g_remset_cap == 0)
+    {
+        return;
+    }
+
+    // Rebuilding the table is the simplest way to drop cards without breaking the probe sequences of the others
+    p_old = g_remset;
+    old_cap = g_remset_cap;
+
+    g_remset = cards_alloc(old_cap);
+    if (g_remset == NULL) // empty cards are harmless, so just keep them
+    {
+        g_remset = p_old;
+
+        return;
+    }
+
+    g_remset_count = 0;
+    for (idx = 0; idx < old_cap; idx++)
+    {
+        if (p_old[idx].card != 0 && p_old[idx].words != 0)
+        {
+            for (new_idx = card_hash(p_old[idx].card, old_cap); g_remset[new_idx].card != 0; new_idx = (new_idx + 1) & (old_cap - 1))
+                ;
+
+            g_remset[new_idx] = p_old[idx];
+            g_remset_count++;
+        }
+    }
+
+    cards_free(p_old, old_cap);
+
+    return;
+}
+
+void remset_clear(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < g_remset_cap; idx++)
+    {
+        g_remset[idx].card = 0;
+    }
+
+    g_remset_count = 0;
+    g_remset_overflow = false; // a collection of every generation is about to remember everything again
+
+    return;
+}
+
+void remset_free(void)
+{
+    cards_free(g_remset, g_remset_cap);
+    g_remset = NULL;
+    g_remset_cap = g_remset_count = 0;
+    g_remset_overflow = false;
+
+    return;
+}
+
+static size_t card_hash(uintptr_t card, size_t cap)
+{
+    // Fibonacci hashing spreads out consecutive cards, which are the common case
+    return (size_t) ((card * UINT64_C(0x9e3779b97f4a7c15)) >> 32) & (cap - 1);
+}
+
+static remset_card *card_find(uintptr_t card)
+{
+    size_t idx;
+
+    for (idx = card_hash(card, g_remset_cap); g_remset[idx].card != 0; idx = (idx + 1) & (g_remset_cap - 1))
+    {
+        if (g_remset[idx].card == card)
+        {
+            return &g_remset[idx];
+        }
+    }
+
+    return NULL;
+}
+
+static remset_card *card_insert(uintptr_t card)
+{
+    size_t idx;
+
+    if (g_remset_count + 1 > g_remset_cap / 2 && !remset_grow()) // keep the load factor at or below one half
+    {
+        return NULL;
+    }
+
+    // Linear probing; the card is either already present or gets the first empty slot
+    for (idx = card_hash(card, g_remset_cap); g_remset[idx].card != 0 && g_remset[idx].card != card; idx = (idx + 1) & (g_remset_cap - 1))
+        ;
+
+    if (g_remset[idx].card == 0)
+    {
+        g_remset[idx].card = card;
+        g_remset[idx].words = 0;
+        g_remset_count++;
+    }
+
+    return &g_remset[idx];
+}
+
+static bool remset_grow(void)
+{
+    size_t idx, new_idx, new_cap;
+    remset_card *p_new;
+
+    new_cap = (g_remset_cap == 0) ? REMSET_INITIAL_SIZE : 2 * g_remset_cap;
+    p_new = cards_alloc(new_cap);
+    if (p_new == NULL)
+    {
+        return false;
+    }
+
+    for (idx = 0; idx < g_remset_cap; idx++)
+    {
+        if (g_remset[idx].card != 0)
+        {
+            for (new_idx = card_hash(g_remset[idx].card, new_cap); p_new[new_idx].card != 0; new_idx = (new_idx + 1) & (new_cap - 1))
+                ;
+
+            p_new[new_idx] = g_remset[idx];
+        }
+    }
+
+    cards_free(g_remset, g_remset_cap);
+    g_remset = p_new;
+    g_remset_cap = new_cap;
+
+    return true;
+}
+
+static remset_card *cards_alloc(size_t cap)
+{
+    remset_card *p_cards;
+
+    // Collections remember words while the other threads are stopped, when one of them may be holding a lock inside
+    // `malloc()`, so the table is mapped on its own (which also zeroes it)
+    p_cards = mmap(NULL, cap * sizeof(remset_card), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return (p_cards == MAP_FAILED) ? NULL : p_cards;
+}
+
+static void cards_free(remset_card *p_cards, size_t cap)
+{
+    if (p_cards != NULL)
+    {
+        munmap(p_cards, cap * sizeof(remset_card));
+    }
+
+    return;
+}
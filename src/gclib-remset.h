@@ -0,0 +1,57 @@
+#ifndef GCLIB_REMSET_H
+#define GCLIB_REMSET_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CARD_SHIFT 9                                         // log2 of the number of bytes covered by each card
+#define CARD_WORDS ((1 << CARD_SHIFT) / sizeof(void *))     // number of pointer-sized words covered by each card (must be 64)
+#define REMSET_INITIAL_SIZE 256
+#define REMSET_BUFFER_WORDS 256                              // number of words a registered thread remembers on its own before they have to be added to the remembered set
+
+/* A dirty card: a `1 << CARD_SHIFT`-byte aligned range of memory with a bit for each word that may hold a reference from an older chunk to a younger one. */
+typedef struct remset_card
+{
+    uintptr_t card;  // address of the card shifted right by `CARD_SHIFT`; 0 marks an empty slot
+    uint64_t words;  // bit `i` is set if the `i`th word of the card is remembered
+} remset_card;
+
+/* Words remembered by a single thread without taking `g_gclib_lock`, which are added to the remembered set by whoever holds it. */
+typedef struct remset_buffer
+{
+    const void *words[REMSET_BUFFER_WORDS];
+    size_t len;     // number of words in `words`; only the owning thread adds to it, and it is only emptied while that thread holds `g_gclib_lock`
+    size_t merged;  // number of words at the start of `words` that have been added to the remembered set already
+} remset_buffer;
+
+extern remset_card *g_remset;
+extern size_t g_remset_cap;
+extern size_t g_remset_count;
+extern bool g_remset_overflow;
+
+/* Remember the word at `ptr`, which must be aligned. Set `g_remset_overflow` if there wasn't enough memory to do so. */
+void remset_add(const void *ptr);
+
+/* Remember every word within the `size` bytes starting at `ptr`, which must be aligned. Set `g_remset_overflow` if there wasn't enough memory to do so. */
+void remset_add_range(const void *ptr, size_t size);
+
+/* Forget every remembered word within the `size` bytes starting at `ptr`, which is memory that is about to be freed. */
+void remset_forget(const void *ptr, size_t size);
+
+/* Remember the word at the same offset from `new_ptr` for every remembered word within the `size` bytes starting at `ptr`, which is memory whose contents are being moved there. */
+void remset_move(const void *ptr, const void *new_ptr, size_t size);
+
+/* Remove the cards whose words have all been cleared in place. */
+void remset_compact(void);
+
+/* Forget every remembered word, clearing `g_remset_overflow`. */
+void remset_clear(void);
+
+/* Free the memory used by the remembered set. */
+void remset_free(void);
+
+
+#endif // GCLIB_REMSET_H
@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "gclib-site.h"
+#include "gclib-table.h"
+
+bool g_site_tracking; // whether chunks remember the site they were allocated from, which pretenures the sites whose chunks mostly survive
+
+static alloc_site g_sites[SITE_MAX + 1]; // sites by index, starting at 1
+static size_t g_sites_count;             // number of sites in `g_sites`
+static uint8_t g_site_slots[SITE_SLOTS]; // open-addressing hash table of the indices of the sites in `g_sites`, keyed by `key`; 0 marks an empty slot
+
+uint8_t site_lookup(uintptr_t key)
+{
+    size_t idx;
+
+    if (key == 0)
+    {
+        return 0;
+    }
+
+    // Linear probing; the table is never more than half full, so there is always an empty slot to end the search
+    for (idx = table_hash_ptr((const void *) key) & (SITE_SLOTS - 1); g_site_slots[idx] != 0; idx = (idx + 1) & (SITE_SLOTS - 1))
+    {
+        if (g_sites[g_site_slots[idx]].key == key)
+        {
+            return g_site_slots[idx];
+        }
+    }
+
+    if (g_sites_count == SITE_MAX) // chunks from any further sites are simply not tracked
+    {
+        return 0;
+    }
+
+    g_sites_count++;
+    g_sites[g_sites_count].key = key;
+    g_site_slots[idx] = g_sites_count;
+
+    return g_sites_count;
+}
+
+bool site_pretenure(uint8_t site)
+{
+    alloc_site *p_site;
+
+    p_site = &g_sites[site];
+    if (!p_site->pretenure)
+    {
+        return false;
+    }
+
+    p_site->allocs++;
+
+    return p_site->allocs % SITE_RESAMPLE_EVERY != 0;
+}
+
+void site_note_sweep(uint8_t site, bool survived)
+{
+    alloc_site *p_site;
+
+    p_site = &g_sites[site];
+    p_site->swept++;
+    p_site->survived += survived;
+
+    // Each judgement only rests on the chunks swept since the last one, so that a site whose chunks start (or stop)
+    // living long is found out after a single sample
+    if (p_site->swept >= SITE_SAMPLE_CHUNKS)
+    {
+        p_site->pretenure = (uint64_t) p_site->survived * 100 >= (uint64_t) p_site->swept * SITE_PRETENURE_PERCENT;
+        p_site->swept = p_site->survived = p_site->allocs = 0;
+    }
+
+    return;
+}
+
+void site_free_all(void)
+{
+    memset(g_sites, 0, sizeof(g_sites));
+    memset(g_site_slots, 0, sizeof(g_site_slots));
+    g_sites_count = 0;
+
+    return;
+}
@@ -0,0 +1,40 @@
+#ifndef GCLIB_SITE_H
+#define GCLIB_SITE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A place in the program that allocates chunks, along with how many of them survived their first collection. */
+typedef struct alloc_site
+{
+    uintptr_t key;      // return address of the allocation or site passed to `gclib_alloc_site()`
+    uint32_t swept;     // chunks from the site swept for the first time since its survival rate was last judged
+    uint32_t survived;  // how many of those were reachable
+    uint32_t allocs;    // chunks allocated from the site since it was pretenured
+    bool pretenure;     // whether new chunks from the site start out in the oldest generation
+} alloc_site;
+
+#define SITE_MAX UINT8_MAX          // number of sites that are tracked at most, since `chunk_node`s refer to them by a byte (with 0 standing for none)
+#define SITE_SLOTS 512              // number of slots of the hash table from keys to sites (a power of two, at least twice `SITE_MAX`)
+#define SITE_SAMPLE_CHUNKS 256      // number of a site's chunks that have to be swept before its survival rate is judged (again)
+#define SITE_PRETENURE_PERCENT 90   // survival rate from which a site is pretenured
+#define SITE_RESAMPLE_EVERY 16      // one in this many chunks from a pretenured site still starts out in generation 0, so that the site is pretenured no longer once its chunks stop surviving
+
+extern bool g_site_tracking;
+
+/* Return the index of the site `key`, which starts to be tracked if it wasn't already, or 0 if `key` is 0 or `SITE_MAX` other sites are tracked already. */
+uint8_t site_lookup(uintptr_t key);
+
+/* Return whether the chunk about to be allocated from the site at index `site` should start out in the oldest generation. */
+bool site_pretenure(uint8_t site);
+
+/* Count a chunk from the site at index `site` that a collection swept for the first time, and whether it survived. */
+void site_note_sweep(uint8_t site, bool survived);
+
+/* Forget every site. */
+void site_free_all(void);
+
+
+#endif // GCLIB_SITE_H
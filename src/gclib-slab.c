@@ -0,0 +1,609 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "gclib-remset.h"
+#include "gclib-slab.h"
+#include "gclib-weak.h"
+
+bool g_slab_enabled;          // whether small allocations are served from `slab_page`s instead of `malloc()`
+slab_page **g_slab_pages;     // every `slab_page`, sorted by address
+size_t g_slab_page_count;     // number of `slab_page`s in `g_slab_pages`
+size_t g_slab_alloced_bytes;  // total size (in bytes) of all allocated objects across all pages
+const void *g_slab_min_ptr;   // address of the lowest page
+const void *g_slab_max_ptr;   // address one past the end of the highest page
+
+static slab_page *g_slab_available[2][SLAB_CLASSES]; // linked lists of the pages in each size class that have free objects, for scanned and atomic objects
+static size_t g_slab_page_cap;                    // number of `slab_page *`s that `g_slab_pages` has room for
+static pthread_mutex_t g_slab_pages_lock = PTHREAD_MUTEX_INITIALIZER; // held while `g_slab_pages` changes, so that the background marker can look pages up
+
+static size_t slab_class_size(uint8_t size_class);
+static uint64_t slab_tail_bits(uint16_t objects);
+static slab_page *page_create(uint8_t size_class, bool atomic);
+static void page_release(size_t idx);
+static void pages_update_bounds(void);
+
+void *slab_alloc(size_t size, bool zeroed, bool atomic)
+{
+    uint8_t size_class;
+    uint16_t word;
+    uint64_t free_bits;
+    size_t object_size;
+    void *ptr;
+    slab_page *p_page;
+
+    size_class = slab_size_class(size);
+    object_size = slab_class_size(size_class);
+
+    p_page = g_slab_available[atomic][size_class];
+    if (p_page == NULL)
+    {
+        p_page = page_create(size_class, atomic);
+        if (p_page == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    // Every object before `cursor` is allocated and `free_count` guarantees that a free object comes after it
+    for (word = p_page->cursor; ~p_page->alloc_bits[word] == 0; word++)
+        ;
+
+    free_bits = ~p_page->alloc_bits[word];
+    p_page->alloc_bits[word] |= free_bits & -free_bits; // claim the lowest free object in this word
+    p_page->cursor = word;
+    p_page->free_count--;
+
+    if (p_page->free_count == 0) // the page is full so stop allocating from it; it is always the head of its list
+    {
+        g_slab_available[atomic][size_class] = p_page->next_available;
+        p_page->available = false;
+    }
+
+    ptr = p_page->base + (word * 64 + __builtin_ctzll(free_bits)) * object_size;
+    g_slab_alloced_bytes += object_size;
+
+    if (zeroed)
+    {
+        memset(ptr, 0, object_size); // zero the whole object since all of it gets scanned during the mark phase
+    }
+
+    return ptr;
+}
+
+void *slab_tlab_alloc(slab_page *p_page, bool zeroed)
+{
+    uint16_t word;
+    uint64_t bit;
+    size_t object_size;
+    void *ptr;
+
+    if (p_page == NULL)
+    {
+        return NULL;
+    }
+
+    // Every object before `cursor` has been handed out. Only the owning thread ever clears reserved bits, so nothing
+    // here needs to be atomic with respect to other threads; collections stop this thread before looking at them.
+    for (word = p_page->cursor; word < SLAB_BITMAP_WORDS && p_page->reserved_bits[word] == 0; word++)
+        ;
+
+    if (word == SLAB_BITMAP_WORDS)
+    {
+        p_page->cursor = word;
+
+        return NULL;
+    }
+
+    bit = p_page->reserved_bits[word] & -p_page->reserved_bits[word];
+    object_size = slab_object_size(p_page);
+    ptr = p_page->base + (word * 64 + __builtin_ctzll(bit)) * object_size;
+
+    // A collection that stops the thread in between finds `ptr` in its registers, so the object is never swept
+    // while it is neither reserved nor referenced
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    p_page->reserved_bits[word] &= ~bit;
+    p_page->cursor = word;
+
+    if (zeroed)
+    {
+        memset(ptr, 0, object_size);
+    }
+
+    return ptr;
+}
+
+size_t slab_tlab_refill(slab_page **pp_tlab, uint8_t size_class, bool atomic)
+{
+    uint16_t word;
+    size_t reserved;
+    slab_page *p_page;
+
+    slab_tlab_retire(pp_tlab);
+
+    p_page = g_slab_available[atomic][size_class];
+    if (p_page == NULL)
+    {
+        p_page = page_create(size_class, atomic);
+        if (p_page == NULL)
+        {
+            return 0;
+        }
+    }
+
+    // Take the page off its list and count all of its free objects as allocated up front
+    g_slab_available[atomic][size_class] = p_page->next_available;
+    p_page->available = false;
+
+    for (word = 0; word < SLAB_BITMAP_WORDS; word++)
+    {
+        p_page->reserved_bits[word] = ~p_page->alloc_bits[word];
+        p_page->alloc_bits[word] = ~UINT64_C(0);
+    }
+
+    reserved = p_page->free_count * slab_object_size(p_page);
+    g_slab_alloced_bytes += reserved;
+    p_page->free_count = 0;
+    p_page->cursor = 0;
+    p_page->owned = true;
+    *pp_tlab = p_page;
+
+    return reserved;
+}
+
+void slab_tlab_retire(slab_page **pp_tlab)
+{
+    uint16_t word, unused;
+    slab_page *p_page;
+
+    p_page = *pp_tlab;
+    if (p_page == NULL)
+    {
+        return;
+    }
+
+    unused = 0;
+    for (word = 0; word < SLAB_BITMAP_WORDS; word++)
+    {
+        p_page->alloc_bits[word] &= ~p_page->reserved_bits[word];
+        unused += __builtin_popcountll(p_page->reserved_bits[word]);
+        p_page->reserved_bits[word] = 0;
+    }
+
+    g_slab_alloced_bytes -= unused * slab_object_size(p_page);
+    p_page->free_count += unused;
+    p_page->cursor = 0;
+    p_page->owned = false;
+
+    if (p_page->free_count > 0)
+    {
+        p_page->next_available = g_slab_available[p_page->atomic][p_page->size_class];
+        g_slab_available[p_page->atomic][p_page->size_class] = p_page;
+        p_page->available = true;
+    }
+
+    *pp_tlab = NULL;
+
+    return;
+}
+
+void slab_free(void *ptr)
+{
+    size_t object_size, idx;
+    slab_page *p_page;
+
+    p_page = slab_find_page(ptr);
+    if (p_page == NULL)
+    {
+        return;
+    }
+
+    object_size = slab_object_size(p_page);
+    idx = (size_t) (ptr - p_page->base) / object_size;
+    if (p_page->base + idx * object_size != ptr || !(p_page->alloc_bits[idx / 64] & (UINT64_C(1) << (idx % 64))))
+    {
+        return; // not the start of an allocated object
+    }
+
+    remset_forget(ptr, object_size);
+    weak_forget(ptr);
+    p_page->alloc_bits[idx / 64] &= ~(UINT64_C(1) << (idx % 64));
+    __atomic_fetch_and(&p_page->mark_bits[idx / 64], ~(UINT64_C(1) << (idx % 64)), __ATOMIC_RELAXED); // the background marker may be marking a neighbor
+    p_page->free_count++;
+    g_slab_alloced_bytes -= object_size;
+
+    if (p_page->owned) // its owner may be allocating from it right now; the object is only reused once the page is retired
+    {
+        return;
+    }
+
+    if (idx / 64 < p_page->cursor)
+    {
+        p_page->cursor = idx / 64;
+    }
+
+    if (!p_page->available)
+    {
+        p_page->next_available = g_slab_available[p_page->atomic][p_page->size_class];
+        g_slab_available[p_page->atomic][p_page->size_class] = p_page;
+        p_page->available = true;
+    }
+
+    return;
+}
+
+slab_page *slab_find_page(const void *ptr)
+{
+    size_t low, high, mid;
+    slab_page *p_page;
+
+    if (ptr < g_slab_min_ptr || g_slab_max_ptr <= ptr)
+    {
+        return NULL;
+    }
+
+    // Binary search for the last page starting at or below `ptr`
+    low = 0;
+    high = g_slab_page_count;
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (g_slab_pages[mid]->base <= ptr)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    p_page = g_slab_pages[low];
+    if (p_page->base <= ptr && ptr < p_page->base + SLAB_PAGE_SIZE)
+    {
+        return p_page;
+    }
+
+    return NULL;
+}
+
+size_t slab_object_size(const slab_page *p_page)
+{
+    return slab_class_size(p_page->size_class);
+}
+
+bool slab_is_allocated(const void *ptr)
+{
+    size_t idx;
+    slab_page *p_page;
+
+    p_page = slab_find_page(ptr);
+    if (p_page == NULL)
+    {
+        return false;
+    }
+
+    idx = (size_t) (ptr - p_page->base) / slab_object_size(p_page);
+
+    return idx < p_page->objects && (p_page->alloc_bits[idx / 64] & ~p_page->reserved_bits[idx / 64] & (UINT64_C(1) << (idx % 64)));
+}
+
+bool slab_mark(const void *ptr, const void ***p_start, const void ***p_end)
+{
+    size_t object_size, idx;
+    uint64_t bit;
+    slab_page *p_page;
+
+    p_page = slab_find_page(ptr);
+    if (p_page == NULL)
+    {
+        return false;
+    }
+
+    object_size = slab_object_size(p_page);
+    idx = (size_t) (ptr - p_page->base) / object_size; // interior pointers belong to the object they point into
+    if (idx >= p_page->objects)
+    {
+        return false; // in the unused space at the end of the page
+    }
+
+    bit = UINT64_C(1) << (idx % 64);
+    if (!(p_page->alloc_bits[idx / 64] & ~p_page->reserved_bits[idx / 64] & bit) || (p_page->mark_bits[idx / 64] & bit)) // reserved objects hold nothing yet
+    {
+        return false;
+    }
+
+    if (__atomic_fetch_or(&p_page->mark_bits[idx / 64], bit, __ATOMIC_RELAXED) & bit) // another marker got to it first
+    {
+        return false;
+    }
+
+    *p_start = p_page->base + idx * object_size;
+    *p_end = p_page->atomic ? *p_start : p_page->base + (idx + 1) * object_size;
+
+    return true;
+}
+
+size_t slab_sweep(size_t *p_live)
+{
+    uint16_t word, live;
+    size_t idx, object_size, freed;
+    slab_page *p_page;
+
+    freed = *p_live = 0;
+
+    for (idx = 0; idx < SLAB_CLASSES; idx++)
+    {
+        g_slab_available[false][idx] = g_slab_available[true][idx] = NULL;
+    }
+
+    for (idx = 0; idx < g_slab_page_count; idx++)
+    {
+        p_page = g_slab_pages[idx];
+        object_size = slab_object_size(p_page);
+
+        // Unmarked objects become free simply by clearing their allocation bits, except for the ones a thread has
+        // reserved but not handed out yet
+        live = 0;
+        for (word = 0; word < SLAB_BITMAP_WORDS; word++)
+        {
+            p_page->alloc_bits[word] &= p_page->mark_bits[word] | p_page->reserved_bits[word];
+            p_page->mark_bits[word] = 0;
+            live += __builtin_popcountll(p_page->alloc_bits[word]);
+        }
+        p_page->alloc_bits[(p_page->objects - 1) / 64] |= slab_tail_bits(p_page->objects);
+        for (word = (p_page->objects - 1) / 64 + 1; word < SLAB_BITMAP_WORDS; word++)
+        {
+            p_page->alloc_bits[word] = ~UINT64_C(0);
+        }
+
+        freed += p_page->objects - p_page->free_count - live;
+        *p_live += live;
+        g_slab_alloced_bytes -= (p_page->objects - p_page->free_count - live) * object_size;
+        p_page->free_count = p_page->objects - live;
+        p_page->available = false;
+
+        if (p_page->owned) // stays with its thread, whose cursor is still valid
+        {
+            continue;
+        }
+
+        p_page->cursor = 0;
+
+        if (live > 0 && p_page->free_count > 0) // empty pages are left off the lists until they are released
+        {
+            p_page->next_available = g_slab_available[p_page->atomic][p_page->size_class];
+            g_slab_available[p_page->atomic][p_page->size_class] = p_page;
+            p_page->available = true;
+        }
+    }
+
+    return freed;
+}
+
+void slab_release_empty(void)
+{
+    size_t idx;
+    slab_page *p_page;
+
+    slab_lock_pages();
+
+    // Iterate in reverse so that releasing a page doesn't shift the ones that are still to be checked
+    for (idx = g_slab_page_count; idx-- > 0;)
+    {
+        p_page = g_slab_pages[idx];
+        if (!p_page->owned && !p_page->available && p_page->free_count == p_page->objects)
+        {
+            page_release(idx);
+        }
+    }
+
+    pages_update_bounds();
+
+    slab_unlock_pages();
+
+    return;
+}
+
+void slab_lock_pages(void)
+{
+    pthread_mutex_lock(&g_slab_pages_lock);
+
+    return;
+}
+
+void slab_unlock_pages(void)
+{
+    pthread_mutex_unlock(&g_slab_pages_lock);
+
+    return;
+}
+
+void slab_print(FILE *stream)
+{
+    uint32_t count;
+    size_t bytes, idx, object;
+    slab_page *p_page;
+
+    count = bytes = 0;
+    fprintf(stream, "Slab pages:\n\n");
+
+    for (idx = 0; idx < g_slab_page_count; idx++)
+    {
+        p_page = g_slab_pages[idx];
+        for (object = 0; object < p_page->objects; object++)
+        {
+            if (p_page->alloc_bits[object / 64] & ~p_page->reserved_bits[object / 64] & (UINT64_C(1) << (object % 64)))
+            {
+                count++;
+                bytes += slab_object_size(p_page);
+
+                fprintf(stream, "\tUnfreed block:\n\t\tAddress: %p\n\t\tSize: %zu (bytes)\n\n", p_page->base + object * slab_object_size(p_page), slab_object_size(p_page));
+            }
+        }
+    }
+
+    fprintf(stream, "\nSLAB TOTAL:\n\tUnfreed chunks: %d\n\tUnfreed bytes: %zu\n", count, bytes);
+
+    return;
+}
+
+void slab_free_all(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < g_slab_page_count; idx++)
+    {
+        free(g_slab_pages[idx]->base);
+        free(g_slab_pages[idx]);
+    }
+
+    for (idx = 0; idx < SLAB_CLASSES; idx++)
+    {
+        g_slab_available[false][idx] = g_slab_available[true][idx] = NULL;
+    }
+
+    free(g_slab_pages);
+    g_slab_pages = NULL;
+    g_slab_page_count = g_slab_page_cap = 0;
+    g_slab_alloced_bytes = 0;
+    pages_update_bounds();
+
+    return;
+}
+
+uint8_t slab_size_class(size_t size)
+{
+    uint8_t group;
+    size_t last;
+
+    // Classes go up in steps of 16 bytes until 128, then in four equal steps between each power of two
+    last = size - 1;
+    if (last < 128)
+    {
+        return last / 16;
+    }
+
+    group = (63 - __builtin_clzll(last)) - 7;
+
+    return 8 + 4 * group + (last - (128 << group)) / (32 << group);
+}
+
+static size_t slab_class_size(uint8_t size_class)
+{
+    uint8_t group;
+
+    if (size_class < 8)
+    {
+        return SLAB_MIN_SIZE * (size_class + 1);
+    }
+
+    group = (size_class - 8) / 4;
+
+    return (128 << group) + ((size_class - 8) % 4 + 1) * (32 << group);
+}
+
+static uint64_t slab_tail_bits(uint16_t objects)
+{
+    if (objects % 64 == 0)
+    {
+        return 0;
+    }
+
+    return ~UINT64_C(0) << (objects % 64); // bits for objects past the end of the page in the last used word of a bitmap
+}
+
+static slab_page *page_create(uint8_t size_class, bool atomic)
+{
+    size_t idx, new_cap;
+    uint16_t word;
+    slab_page *p_page, **p_new_pages;
+
+    p_page = calloc(1, sizeof(slab_page));
+    if (p_page == NULL)
+    {
+        return NULL;
+    }
+
+    p_page->base = aligned_alloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+    if (p_page->base == NULL)
+    {
+        free(p_page);
+
+        return NULL;
+    }
+
+    p_page->size_class = size_class;
+    p_page->atomic = atomic;
+    p_page->objects = SLAB_PAGE_SIZE / slab_class_size(size_class);
+    p_page->free_count = p_page->objects;
+
+    // Objects that don't exist are permanently allocated so that the search for a free object never finds them
+    p_page->alloc_bits[(p_page->objects - 1) / 64] = slab_tail_bits(p_page->objects);
+    for (word = (p_page->objects - 1) / 64 + 1; word < SLAB_BITMAP_WORDS; word++)
+    {
+        p_page->alloc_bits[word] = ~UINT64_C(0);
+    }
+
+    slab_lock_pages();
+
+    if (g_slab_page_count == g_slab_page_cap)
+    {
+        new_cap = (g_slab_page_cap == 0) ? 64 : 2 * g_slab_page_cap;
+        p_new_pages = realloc(g_slab_pages, new_cap * sizeof(slab_page *));
+        if (p_new_pages == NULL)
+        {
+            slab_unlock_pages();
+            free(p_page->base);
+            free(p_page);
+
+            return NULL;
+        }
+
+        g_slab_pages = p_new_pages;
+        g_slab_page_cap = new_cap;
+    }
+
+    // Keep `g_slab_pages` sorted by address
+    for (idx = g_slab_page_count; idx > 0 && g_slab_pages[idx - 1]->base > p_page->base; idx--)
+    {
+        g_slab_pages[idx] = g_slab_pages[idx - 1];
+    }
+    g_slab_pages[idx] = p_page;
+    g_slab_page_count++;
+    pages_update_bounds();
+
+    slab_unlock_pages();
+
+    p_page->next_available = g_slab_available[atomic][size_class];
+    g_slab_available[atomic][size_class] = p_page;
+    p_page->available = true;
+
+    return p_page;
+}
+
+static void page_release(size_t idx)
+{
+    remset_forget(g_slab_pages[idx]->base, SLAB_PAGE_SIZE);
+    free(g_slab_pages[idx]->base);
+    free(g_slab_pages[idx]);
+
+    memmove(&g_slab_pages[idx], &g_slab_pages[idx + 1], (g_slab_page_count - idx - 1) * sizeof(slab_page *));
+    g_slab_page_count--;
+
+    return;
+}
+
+static void pages_update_bounds(void)
+{
+    if (g_slab_page_count == 0)
+    {
+        g_slab_min_ptr = g_slab_max_ptr = NULL;
+
+        return;
+    }
+
+    g_slab_min_ptr = g_slab_pages[0]->base;
+    g_slab_max_ptr = g_slab_pages[g_slab_page_count - 1]->base + SLAB_PAGE_SIZE;
+
+    return;
+}
@@ -0,0 +1,90 @@
+#ifndef GCLIB_SLAB_H
+#define GCLIB_SLAB_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SLAB_PAGE_SIZE 65536                       // size (and alignment) of the memory backing each `slab_page`
+#define SLAB_MIN_SIZE 16                           // size of the smallest size class; every size class is a multiple of this
+#define SLAB_MAX_SIZE 2048                         // size of the largest size class; larger allocations go through `malloc()`
+#define SLAB_CLASSES 24                            // number of size classes between `SLAB_MIN_SIZE` and `SLAB_MAX_SIZE`
+#define SLAB_BITMAP_WORDS (SLAB_PAGE_SIZE / SLAB_MIN_SIZE / 64) // number of `uint64_t`s needed for one bit per object in a page
+
+/* A page of equally sized objects carved out for one size class. The objects themselves carry no metadata. */
+typedef struct slab_page
+{
+    void *base;
+    uint8_t size_class;
+    uint16_t objects;                        // number of objects that fit in the page
+    uint16_t free_count;                     // number of objects that are not allocated
+    uint16_t cursor;                         // index into `alloc_bits` before which every object is allocated
+    bool atomic;                             // whether the objects in the page are never scanned
+    bool available;                          // whether the page is linked into `g_slab_available[atomic][size_class]`
+    bool owned;                              // whether the page is a thread's allocation buffer, which only that thread allocates from
+    struct slab_page *next_available;
+    uint64_t alloc_bits[SLAB_BITMAP_WORDS];  // bit `i` is set if object `i` is allocated (or doesn't exist)
+    uint64_t mark_bits[SLAB_BITMAP_WORDS];   // bit `i` is set if object `i` was found reachable during the mark phase
+    uint64_t reserved_bits[SLAB_BITMAP_WORDS]; // bit `i` is set if object `i` is counted as allocated but hasn't been handed out by the owning thread yet
+} slab_page;
+
+extern bool g_slab_enabled;
+extern slab_page **g_slab_pages;
+extern size_t g_slab_page_count;
+extern size_t g_slab_alloced_bytes;
+extern const void *g_slab_min_ptr;
+extern const void *g_slab_max_ptr;
+
+/* Allocate an object of at least `size` bytes (at most `SLAB_MAX_SIZE`) from the pages of its size class, which are separate for objects that are never scanned (`atomic`). */
+void *slab_alloc(size_t size, bool zeroed, bool atomic);
+
+/* Allocate an object from the thread-owned page `*p_page` (which may be `NULL`) without touching any shared state. Return `NULL` once the page has nothing left to hand out. */
+void *slab_tlab_alloc(slab_page *p_page, bool zeroed);
+
+/* Give up the page in `*pp_tlab` (if any) and replace it with a page of the given size class that the calling thread owns. Return the number of bytes reserved for the thread, or 0 if no page could be found or created. */
+size_t slab_tlab_refill(slab_page **pp_tlab, uint8_t size_class, bool atomic);
+
+/* Give up the page in `*pp_tlab` (if any), making the objects it had left over available to every thread again. */
+void slab_tlab_retire(slab_page **pp_tlab);
+
+/* Return the size class that an allocation of `size` bytes (at most `SLAB_MAX_SIZE`) is served from. */
+uint8_t slab_size_class(size_t size);
+
+/* Return the object starting at `ptr` to its page. */
+void slab_free(void *ptr);
+
+/* Return the `slab_page` containing the address `ptr`, or `NULL` if `ptr` isn't within any page. */
+slab_page *slab_find_page(const void *ptr);
+
+/* Return the size in bytes of every object in `*p_page`, as given by its size class. */
+size_t slab_object_size(const slab_page *p_page);
+
+/* Return whether `ptr` lies within an allocated object. */
+bool slab_is_allocated(const void *ptr);
+
+/* Mark the allocated object containing the address `ptr` and store the bounds of what has to be scanned of it (nothing for atomic objects) in `*p_start` and `*p_end`. Return `false` if there is no such object or if it was already marked. */
+bool slab_mark(const void *ptr, const void ***p_start, const void ***p_end);
+
+/* Free every object that wasn't marked and clear all mark bits. Pages that are left empty are only released by `slab_release_empty()`. Return the number of objects freed and store the number left allocated in `*p_live`. */
+size_t slab_sweep(size_t *p_live);
+
+/* Release the pages that `slab_sweep()` left empty. */
+void slab_release_empty(void);
+
+/* Keep pages from being added to or removed from `g_slab_pages` until `slab_unlock_pages()`, which a thread marking without `g_gclib_lock` needs for `slab_find_page()` to be safe. */
+void slab_lock_pages(void);
+
+/* Let pages be added to or removed from `g_slab_pages` again. */
+void slab_unlock_pages(void);
+
+/* Print all allocated objects to `stream`. */
+void slab_print(FILE *stream);
+
+/* Free all pages along with the objects they contain. */
+void slab_free_all(void);
+
+
+#endif // GCLIB_SLAB_H
@@ -0,0 +1,94 @@
+#include <string.h>
+#include <time.h>
+
+#include "gclib-stats.h"
+
+gclib_stats g_stats; // running totals returned by `gclib_get_stats()`
+
+static unsigned int g_pause_depth;        // number of `stats_pause_begin()` calls that haven't been ended yet
+static uint64_t g_pause_start;            // time at which the outermost pause being timed started
+static gclib_cycle_callback g_callback;   // called at the start and end of each collection, if not `NULL`
+static void *g_callback_arg;              // passed on to `g_callback`
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void stats_pause_begin(void)
+{
+    if (g_pause_depth++ == 0)
+    {
+        g_pause_start = stats_now_ns();
+    }
+
+    return;
+}
+
+void stats_pause_end(void)
+{
+    uint64_t pause;
+    unsigned int bucket;
+
+    if (--g_pause_depth > 0)
+    {
+        return;
+    }
+
+    pause = stats_now_ns() - g_pause_start;
+    g_stats.pauses++;
+    g_stats.pause_ns_total += pause;
+    if (pause > g_stats.pause_ns_max)
+    {
+        g_stats.pause_ns_max = pause;
+    }
+
+    // Bucket `i` holds pauses of less than 2^`i` microseconds, so it is found by the position of the highest set bit
+    pause /= 1000;
+    bucket = (pause == 0) ? 0 : 64 - __builtin_clzll(pause);
+    g_stats.pause_histogram[(bucket < GCLIB_PAUSE_BUCKETS) ? bucket : GCLIB_PAUSE_BUCKETS - 1]++;
+
+    return;
+}
+
+void stats_reset_pauses(void)
+{
+    g_stats.pauses = 0;
+    g_stats.pause_ns_total = 0;
+    g_stats.pause_ns_max = 0;
+    memset(g_stats.pause_histogram, 0, sizeof(g_stats.pause_histogram));
+
+    return;
+}
+
+void stats_cycle_event(gclib_cycle_event event)
+{
+    if (g_callback != NULL)
+    {
+        g_callback(event, &g_stats, g_callback_arg);
+    }
+
+    return;
+}
+
+void stats_set_callback(gclib_cycle_callback callback, void *p_arg)
+{
+    g_callback = callback;
+    g_callback_arg = p_arg;
+
+    return;
+}
+
+void stats_free(void)
+{
+    memset(&g_stats, 0, sizeof(gclib_stats));
+    g_pause_depth = 0;
+    g_callback = NULL;
+    g_callback_arg = NULL;
+
+    return;
+}
@@ -0,0 +1,31 @@
+#ifndef GCLIB_STATS_H
+#define GCLIB_STATS_H
+
+
+#include "gclib.h"
+
+extern gclib_stats g_stats;
+
+/* Return the current time of the monotonic clock in nanoseconds. */
+uint64_t stats_now_ns(void);
+
+/* Start timing a pause of the program, unless a caller is already timing one that includes it. */
+void stats_pause_begin(void);
+
+/* Stop timing the pause started by the matching `stats_pause_begin()`, adding it to the statistics if it is the outermost one. */
+void stats_pause_end(void);
+
+/* Set the pause statistics back to zero, leaving the rest of them and any pause being timed alone. */
+void stats_reset_pauses(void);
+
+/* Call the callback set with `stats_set_callback()`, if any, for `event`. */
+void stats_cycle_event(gclib_cycle_event event);
+
+/* Set the function called by `stats_cycle_event()` along with the argument passed on to it. */
+void stats_set_callback(gclib_cycle_callback callback, void *p_arg);
+
+/* Reset every statistic to zero and forget the callback. */
+void stats_free(void);
+
+
+#endif // GCLIB_STATS_H
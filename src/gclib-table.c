@@ -1,72 +1,226 @@
 
+#include "gclib-compact.h"
 #include "gclib-table.h"
-
-chunk_node *g_hash_table[GENERATIONS][HASH_TABLE_SIZE]; // hash table containing linked lists of `chunk_node`s representing user-allocated blocks
-size_t g_alloced_bytes[GENERATIONS];                    // total size (in bytes) of all allocations for each generation
-
-void table_insert(void *ptr, size_t size)
+#include "gclib-weak.h"
+
+chunk_node **g_chunk_table;           // open-addressing hash table of the `chunk_node`s representing user-allocated blocks, keyed by address
+size_t g_chunk_table_cap;             // number of slots in `g_chunk_table` (always a power of two)
+size_t g_chunk_count;                 // number of `chunk_node`s in `g_chunk_table`
+uint8_t g_generations;                // number of generations chunks are promoted through (at most `GENERATIONS`)
+size_t g_alloced_bytes[GENERATIONS];  // total size (in bytes) of all allocations for each generation
+chunk_node **g_chunk_index;           // `chunk_node`s of the generations being collected, sorted by address; rebuilt at the start of each collection
+const void **g_chunk_starts;          // start address of each chunk in `g_chunk_index`, packed together so that binary searches stay in cache
+size_t g_chunk_index_len;             // number of `chunk_node`s in `g_chunk_index`
+const void *g_heap_min_ptr;           // lowest address covered by a chunk in `g_chunk_index`
+const void *g_heap_max_ptr;           // address one past the highest address covered by a chunk in `g_chunk_index`
+const void *g_table_min_ptr;          // lowest address any chunk in `g_chunk_table` has covered, which only ever goes down
+const void *g_table_max_ptr;          // address one past the highest address any chunk in `g_chunk_table` has covered, which only ever goes up
+size_t g_table_max_size;              // size of the largest chunk not mapped by `large_alloc()` that `g_chunk_table` has held, which only ever goes up
+chunk_node **g_large_index;           // `chunk_node`s of the large chunks, sorted by address; rebuilt along with `g_chunk_index` since every collection includes them
+size_t g_large_index_len;             // number of `chunk_node`s in `g_large_index`
+const void *g_large_min_ptr;          // lowest address covered by a chunk in `g_large_index`
+const void *g_large_max_ptr;          // address one past the highest address covered by a chunk in `g_large_index`
+
+static size_t g_chunk_index_cap; // number of `chunk_node *`s that `g_chunk_index` has room for
+static size_t g_large_index_cap; // number of `chunk_node *`s that `g_large_index` has room for
+static chunk_node **g_node_blocks;  // blocks of `TABLE_NODE_BLOCK` `chunk_node`s that every node is carved out of
+static size_t g_node_blocks_len;    // number of blocks in `g_node_blocks`
+static size_t g_node_blocks_cap;    // number of blocks `g_node_blocks` has room for
+static size_t g_node_block_used;    // number of nodes carved out of the last block so far
+static chunk_node *g_free_nodes;    // nodes that were released, linked through their `ptr`
+
+static int index_compare(const void *p_a, const void *p_b);
+static size_t slot_find(const void *ptr);
+static void slot_delete(size_t idx);
+static bool table_grow(void);
+static chunk_node *node_alloc(void);
+static bool large_index_append(chunk_node *p_node);
+static void table_bounds_extend(const void *ptr, size_t size, bool large);
+
+chunk_node *table_insert(void *ptr, size_t size, const gclib_layout *p_layout, bool large)
 {
-    uint16_t idx;
+    size_t idx;
     chunk_node *p_node;
 
+    if (g_chunk_count + 1 > g_chunk_table_cap / 2 && !table_grow() && g_chunk_count + 1 >= g_chunk_table_cap) // keep the load factor at or below one half, but use up the remaining slots (save one to end the probe sequences) if the table can't grow
+    {
+        return NULL;
+    }
+
     // Allocate and initialze new `chunk_node`
-    p_node = malloc(sizeof(chunk_node)); // using `malloc()` for internal memory needs shouldn't interfere with the collector
+    p_node = node_alloc();
     if (p_node == NULL)
     {
-        return;
+        return NULL;
     }
 
     p_node->ptr = ptr;
     p_node->size = size;
+    p_node->gen = 0; // new allocations start out in generation 0
+    p_node->age = 0;
     p_node->reachable = false; // handled during the mark phase of the collector
+    p_node->indexed = false; // only the chunks that existed when the last collection started are swept by it
+    p_node->dead = false;
+    p_node->pinned = false;
+    p_node->large = large;
+    p_node->site = 0;
+    p_node->p_layout = p_layout;
+
+    // Linear probing; `ptr` can't already be present since it was just returned by the allocator
+    for (idx = table_hash_ptr(ptr) & (g_chunk_table_cap - 1); g_chunk_table[idx] != NULL; idx = (idx + 1) & (g_chunk_table_cap - 1))
+        ;
+
+    g_chunk_table[idx] = p_node;
+    g_chunk_count++;
+    table_bounds_extend(ptr, size, large);
+    g_alloced_bytes[0] += size;
+
+    return p_node;
+}
+
+size_t table_remove(void *ptr)
+{
+    size_t idx, size;
+    chunk_node *p_node;
+
+    idx = slot_find(ptr);
+    if (idx == SIZE_MAX)
+    {
+        return 0;
+    }
+
+    p_node = g_chunk_table[idx];
+    size = p_node->size;
+    slot_delete(idx);
+    g_chunk_count--;
+    g_alloced_bytes[p_node->gen] -= p_node->size;
+    remset_forget(p_node->ptr, p_node->size); // the chunk is being freed or moved
+    weak_forget(p_node->ptr);
+
+    if (p_node->indexed) // a pending sweep still has to get to it, which will free it instead
+    {
+        p_node->ptr = NULL;
+    }
+    else
+    {
+        table_release_node(p_node);
+    }
+
+    return size;
+}
+
+bool table_reserve(size_t count)
+{
+    while (g_chunk_count + count > g_chunk_table_cap / 2)
+    {
+        if (!table_grow())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    idx = table_hash_ptr(ptr);
-    list_link(0, idx, p_node); // insert into generation 0 since it's a new allocation
+void table_release_node(chunk_node *p_node)
+{
+    p_node->ptr = g_free_nodes;
+    g_free_nodes = p_node;
 
     return;
 }
 
-void table_remove(void *ptr)
+size_t table_resize(void *ptr, void *new_ptr, size_t new_size)
 {
-    uint16_t idx;
-    uint8_t gen;
-    chunk_node *p_current, *p_previous;
+    chunk_node *p_node;
 
-    idx = table_hash_ptr(ptr);
-    for (gen = 0; gen < GENERATIONS; gen++)
+    p_node = table_lookup(ptr);
+    if (p_node == NULL)
     {
-        p_previous = NULL;
-        p_current = g_hash_table[gen][idx];
-        while (p_current != NULL)
-        {
-            if (p_current->ptr == ptr) // matches the pointer to remove
-            {
-                list_unlink(gen, idx, p_current, p_previous);
-                free(p_current);
+        return 0;
+    }
 
-                if (p_previous == NULL) // unlinked the head of the list
-                {
-                    p_current = g_hash_table[gen][idx];
-                }
-                else
-                {
-                    p_current = p_previous->next;
-                }
-            }
-            else
-            {
-                p_previous = p_current;
-                p_current = p_current->next;
-            }
+    return table_resize_node(p_node, new_ptr, new_size);
+}
+
+size_t table_resize_node(chunk_node *p_node, void *new_ptr, size_t new_size)
+{
+    size_t idx, old_size;
+    void *ptr;
+
+    ptr = p_node->ptr;
+    old_size = p_node->size;
+
+    if (new_ptr != ptr) // rehash the node under its new address; the number of nodes doesn't change so there's no need to grow
+    {
+        // The node is already known, so its slot is found by comparing nodes rather than addresses
+        for (idx = table_hash_ptr(ptr) & (g_chunk_table_cap - 1); g_chunk_table[idx] != p_node; idx = (idx + 1) & (g_chunk_table_cap - 1))
+            ;
+
+        slot_delete(idx);
+
+        // Older chunks may hold remembered references to younger ones, which have moved along with the contents
+        remset_move(ptr, new_ptr, (new_size < old_size) ? new_size : old_size);
+        remset_forget(ptr, old_size);
+        weak_move(ptr, new_ptr);
+
+        p_node->ptr = new_ptr;
+        for (idx = table_hash_ptr(new_ptr) & (g_chunk_table_cap - 1); g_chunk_table[idx] != NULL; idx = (idx + 1) & (g_chunk_table_cap - 1))
+            ;
+
+        g_chunk_table[idx] = p_node;
+    }
+    else if (new_size < old_size)
+    {
+        remset_forget(ptr + new_size, old_size - new_size); // the tail was given back
+    }
+
+    g_alloced_bytes[p_node->gen] = g_alloced_bytes[p_node->gen] - old_size + new_size;
+    p_node->size = new_size;
+    table_bounds_extend(new_ptr, new_size, p_node->large);
+
+    return old_size;
+}
+
+chunk_node *table_lookup(const void *ptr)
+{
+    size_t idx;
+
+    idx = slot_find(ptr);
+
+    return (idx == SIZE_MAX) ? NULL : g_chunk_table[idx];
+}
+
+void table_set_gen(chunk_node *p_node, uint8_t gen)
+{
+    g_alloced_bytes[p_node->gen] -= p_node->size;
+    g_alloced_bytes[gen] += p_node->size;
+    p_node->gen = gen;
+    p_node->age = 0;
+
+    return;
+}
+
+void table_set_generations(uint8_t count)
+{
+    size_t idx;
+
+    for (idx = 0; count < g_generations && idx < g_chunk_table_cap; idx++)
+    {
+        if (g_chunk_table[idx] != NULL && g_chunk_table[idx]->gen >= count)
+        {
+            table_set_gen(g_chunk_table[idx], count - 1);
         }
     }
 
+    g_generations = count;
+
     return;
 }
 
 void table_print(FILE *stream)
 {
-    uint16_t idx;
+    size_t idx;
     uint8_t gen;
     uint32_t count;
     size_t bytes;
@@ -77,9 +231,10 @@ void table_print(FILE *stream)
     {
         fprintf(stream, "Generation %d:\n\n", gen);
 
-        for (idx = 0; idx < HASH_TABLE_SIZE; idx++)
+        for (idx = 0; idx < g_chunk_table_cap; idx++)
         {
-            for (p_node = g_hash_table[gen][idx]; p_node != NULL; p_node = p_node->next)
+            p_node = g_chunk_table[idx];
+            if (p_node != NULL && p_node->gen == gen)
             {
                 count++;
                 bytes += p_node->size;
@@ -98,32 +253,238 @@ void table_print(FILE *stream)
 
 void table_free(void)
 {
-    uint16_t idx;
+    size_t idx;
     uint8_t gen;
-    chunk_node *p_current, *p_tmp;
+
+    for (idx = 0; idx < g_chunk_table_cap; idx++)
+    {
+        if (g_chunk_table[idx] != NULL)
+        {
+            compact_free(g_chunk_table[idx]->ptr, g_chunk_table[idx]->size);
+        }
+    }
+
+    // Every node (including those that were removed while waiting to be swept) goes along with its block
+    for (idx = 0; idx < g_node_blocks_len; idx++)
+    {
+        free(g_node_blocks[idx]);
+    }
+
+    free(g_node_blocks);
+    g_node_blocks = NULL;
+    g_node_blocks_len = g_node_blocks_cap = g_node_block_used = 0;
+    g_free_nodes = NULL;
+
+    free(g_chunk_table);
+    g_chunk_table = NULL;
+    g_chunk_table_cap = g_chunk_count = 0;
 
     for (gen = 0; gen < GENERATIONS; gen++)
     {
-        for (idx = 0; idx < HASH_TABLE_SIZE; idx++)
+        g_alloced_bytes[gen] = 0;
+    }
+
+    free(g_chunk_index);
+    g_chunk_index = NULL;
+    free(g_chunk_starts);
+    g_chunk_starts = NULL;
+    g_chunk_index_len = g_chunk_index_cap = 0;
+    g_heap_min_ptr = g_heap_max_ptr = NULL;
+    g_table_min_ptr = g_table_max_ptr = NULL;
+    g_table_max_size = 0;
+
+    free(g_large_index);
+    g_large_index = NULL;
+    g_large_index_len = g_large_index_cap = 0;
+    g_large_min_ptr = g_large_max_ptr = NULL;
+
+    return;
+}
+
+bool table_build_index(bool to_index[GENERATIONS])
+{
+    size_t idx, new_cap;
+    chunk_node **p_new_index, *p_node, *p_last;
+    const void **p_new_starts;
+
+    g_chunk_index_len = g_large_index_len = 0;
+    for (idx = 0; idx < g_chunk_table_cap; idx++)
+    {
+        p_node = g_chunk_table[idx];
+        if (p_node == NULL || !to_index[p_node->gen])
+        {
+            continue;
+        }
+
+        if (p_node->large) // large chunks get an index of their own so that they don't widen the heap bounds
         {
-            // Iterate through the linked list and free each node
-            p_current = g_hash_table[gen][idx];
-            while (p_current != NULL)
+            if (!large_index_append(p_node))
             {
-                p_tmp = p_current;
-                p_current = p_current->next;
-                free(p_tmp->ptr);
-                free(p_tmp);
+                break;
             }
+        }
+        else
+        {
+            if (g_chunk_index_len == g_chunk_index_cap)
+            {
+                new_cap = (g_chunk_index_cap == 0) ? TABLE_INITIAL_SIZE : 2 * g_chunk_index_cap;
+                p_new_index = realloc(g_chunk_index, new_cap * sizeof(chunk_node *));
+                if (p_new_index != NULL)
+                {
+                    g_chunk_index = p_new_index;
+                }
+
+                p_new_starts = realloc(g_chunk_starts, new_cap * sizeof(const void *));
+                if (p_new_starts != NULL)
+                {
+                    g_chunk_starts = p_new_starts;
+                }
 
-            g_hash_table[gen][idx] = NULL;
+                if (p_new_index == NULL || p_new_starts == NULL)
+                {
+                    break;
+                }
+
+                g_chunk_index_cap = new_cap;
+            }
+
+            p_node->indexed = true;
+            g_chunk_index[g_chunk_index_len++] = p_node;
         }
     }
 
-    return;
+    if (idx < g_chunk_table_cap) // chunks left out of the index are never marked, so give up on the whole collection instead
+    {
+        while (g_chunk_index_len > 0)
+        {
+            g_chunk_index[--g_chunk_index_len]->indexed = false;
+        }
+
+        while (g_large_index_len > 0)
+        {
+            g_large_index[--g_large_index_len]->indexed = false;
+        }
+
+        g_heap_min_ptr = g_heap_max_ptr = NULL;
+        g_large_min_ptr = g_large_max_ptr = NULL;
+
+        return false;
+    }
+
+    g_large_min_ptr = g_large_max_ptr = NULL;
+    if (g_large_index_len > 0)
+    {
+        qsort(g_large_index, g_large_index_len, sizeof(chunk_node *), index_compare);
+        p_last = g_large_index[g_large_index_len - 1];
+        g_large_min_ptr = g_large_index[0]->ptr;
+        g_large_max_ptr = p_last->ptr + p_last->size;
+    }
+
+    if (g_chunk_index_len == 0)
+    {
+        g_heap_min_ptr = g_heap_max_ptr = NULL; // an empty range rejects every address
+
+        return true;
+    }
+
+    qsort(g_chunk_index, g_chunk_index_len, sizeof(chunk_node *), index_compare);
+    for (idx = 0; idx < g_chunk_index_len; idx++)
+    {
+        g_chunk_starts[idx] = g_chunk_index[idx]->ptr;
+    }
+
+    // Chunks never overlap so the last chunk in address order also ends last
+    p_last = g_chunk_index[g_chunk_index_len - 1];
+    g_heap_min_ptr = g_chunk_index[0]->ptr;
+    g_heap_max_ptr = p_last->ptr + p_last->size;
+
+    return true;
+}
+
+chunk_node *table_find_chunk(const void *ptr)
+{
+    size_t idx;
+    chunk_node *p_node;
+
+    idx = table_find_index(ptr);
+    if (idx == SIZE_MAX)
+    {
+        return table_find_large(ptr);
+    }
+
+    p_node = g_chunk_index[idx];
+    if (ptr < p_node->ptr + p_node->size) // `ptr` points to the start or the interior of the chunk
+    {
+        return p_node;
+    }
+
+    return table_find_large(ptr); // the large chunks may lie anywhere, including between the others
 }
 
-uint16_t table_hash_ptr(const void *ptr)
+chunk_node *table_find_large(const void *ptr)
+{
+    size_t low, high, mid;
+    chunk_node *p_node;
+
+    if (ptr < g_large_min_ptr || g_large_max_ptr <= ptr)
+    {
+        return NULL;
+    }
+
+    // Binary search for the last chunk starting at or below `ptr`
+    low = 0;
+    high = g_large_index_len;
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if ((const void *) g_large_index[mid]->ptr <= ptr)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    p_node = g_large_index[low];
+    if (ptr < p_node->ptr + p_node->size)
+    {
+        return p_node;
+    }
+
+    return NULL;
+}
+
+size_t table_find_index(const void *ptr)
+{
+    size_t low, high, mid;
+
+    if (ptr < g_heap_min_ptr || g_heap_max_ptr <= ptr) // cheap rejection of the vast majority of words that aren't pointers into the heap
+    {
+        return SIZE_MAX;
+    }
+
+    // Binary search for the last chunk starting at or below `ptr`
+    low = 0;
+    high = g_chunk_index_len;
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (g_chunk_starts[mid] <= ptr)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+size_t table_hash_ptr(const void *ptr)
 {
     // From https://stackoverflow.com/a/12996028, which is based on https://xorshift.di.unimi.it/splitmix64.c
 
@@ -133,31 +494,174 @@ uint16_t table_hash_ptr(const void *ptr)
     val = (val ^ (val >> 27)) * UINT64_C(0x94d049bb133111eb);
     val = val ^ (val >> 31);
 
-    return val % HASH_TABLE_SIZE;
+    return val;
 }
 
-void list_link(uint8_t gen, uint16_t idx, chunk_node *p_node)
+static int index_compare(const void *p_a, const void *p_b)
 {
-    p_node->next = g_hash_table[gen][idx];
-    g_hash_table[gen][idx] = p_node;
+    uintptr_t a, b;
 
-    g_alloced_bytes[gen] += p_node->size;
+    a = (uintptr_t) (*(chunk_node *const *) p_a)->ptr;
+    b = (uintptr_t) (*(chunk_node *const *) p_b)->ptr;
+
+    return (a > b) - (a < b);
+}
+
+static size_t slot_find(const void *ptr)
+{
+    size_t idx;
+
+    if (g_chunk_table_cap == 0)
+    {
+        return SIZE_MAX;
+    }
+
+    for (idx = table_hash_ptr(ptr) & (g_chunk_table_cap - 1); g_chunk_table[idx] != NULL; idx = (idx + 1) & (g_chunk_table_cap - 1))
+    {
+        if (g_chunk_table[idx]->ptr == ptr)
+        {
+            return idx;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+static void slot_delete(size_t idx)
+{
+    size_t next, home, mask;
+
+    // Backward-shift deletion: move later entries of the probe sequence into the hole wherever that doesn't put them
+    // before their home slot, so that lookups never need tombstones and stay short no matter how much is freed
+    mask = g_chunk_table_cap - 1;
+    for (next = (idx + 1) & mask; g_chunk_table[next] != NULL; next = (next + 1) & mask)
+    {
+        home = table_hash_ptr(g_chunk_table[next]->ptr) & mask;
+        if (((next - home) & mask) >= ((next - idx) & mask)) // the hole lies between the entry's home slot and the entry
+        {
+            g_chunk_table[idx] = g_chunk_table[next];
+            idx = next;
+        }
+    }
+
+    g_chunk_table[idx] = NULL;
 
     return;
 }
 
-void list_unlink(uint8_t gen, uint16_t idx, chunk_node *p_node, chunk_node *p_previous)
+static bool table_grow(void)
 {
-    if (p_previous == NULL) // `p_node` is the head of the list
+    size_t idx, new_idx, new_cap;
+    chunk_node **p_new;
+
+    new_cap = (g_chunk_table_cap == 0) ? TABLE_INITIAL_SIZE : 2 * g_chunk_table_cap;
+    p_new = calloc(new_cap, sizeof(chunk_node *));
+    if (p_new == NULL)
     {
-        g_hash_table[gen][idx] = p_node->next;
+        return false;
     }
-    else
+
+    for (idx = 0; idx < g_chunk_table_cap; idx++)
+    {
+        if (g_chunk_table[idx] != NULL)
+        {
+            for (new_idx = table_hash_ptr(g_chunk_table[idx]->ptr) & (new_cap - 1); p_new[new_idx] != NULL; new_idx = (new_idx + 1) & (new_cap - 1))
+                ;
+
+            p_new[new_idx] = g_chunk_table[idx];
+        }
+    }
+
+    free(g_chunk_table);
+    g_chunk_table = p_new;
+    g_chunk_table_cap = new_cap;
+
+    return true;
+}
+
+static chunk_node *node_alloc(void)
+{
+    size_t new_cap;
+    chunk_node *p_node, **p_new_blocks;
+
+    // Released nodes are reused first, and new ones are carved out of a block at a time, which saves a call to
+    // `malloc()` for every chunk and keeps the nodes close together for the collector to walk
+    if (g_free_nodes != NULL)
+    {
+        p_node = g_free_nodes;
+        g_free_nodes = p_node->ptr;
+
+        return p_node;
+    }
+
+    if (g_node_blocks_len == 0 || g_node_block_used == TABLE_NODE_BLOCK)
     {
-        p_previous->next = p_node->next;
+        if (g_node_blocks_len == g_node_blocks_cap)
+        {
+            new_cap = (g_node_blocks_cap == 0) ? TABLE_INITIAL_SIZE : 2 * g_node_blocks_cap;
+            p_new_blocks = realloc(g_node_blocks, new_cap * sizeof(chunk_node *));
+            if (p_new_blocks == NULL)
+            {
+                return NULL;
+            }
+
+            g_node_blocks = p_new_blocks;
+            g_node_blocks_cap = new_cap;
+        }
+
+        p_node = malloc(TABLE_NODE_BLOCK * sizeof(chunk_node)); // using `malloc()` for internal memory needs shouldn't interfere with the collector
+        if (p_node == NULL)
+        {
+            return NULL;
+        }
+
+        g_node_blocks[g_node_blocks_len++] = p_node;
+        g_node_block_used = 0;
     }
 
-    g_alloced_bytes[gen] -= p_node->size;
+    return &g_node_blocks[g_node_blocks_len - 1][g_node_block_used++];
+}
+
+static bool large_index_append(chunk_node *p_node)
+{
+    size_t new_cap;
+    chunk_node **p_new_index;
+
+    if (g_large_index_len == g_large_index_cap)
+    {
+        new_cap = (g_large_index_cap == 0) ? TABLE_INITIAL_SIZE : 2 * g_large_index_cap;
+        p_new_index = realloc(g_large_index, new_cap * sizeof(chunk_node *));
+        if (p_new_index == NULL)
+        {
+            return false;
+        }
+
+        g_large_index = p_new_index;
+        g_large_index_cap = new_cap;
+    }
+
+    p_node->indexed = true;
+    g_large_index[g_large_index_len++] = p_node;
+
+    return true;
+}
+
+static void table_bounds_extend(const void *ptr, size_t size, bool large)
+{
+    if (g_table_min_ptr == NULL || ptr < g_table_min_ptr)
+    {
+        g_table_min_ptr = ptr;
+    }
+
+    if (ptr + size > g_table_max_ptr)
+    {
+        g_table_max_ptr = ptr + size;
+    }
+
+    if (!large && size > g_table_max_size)
+    {
+        g_table_max_size = size;
+    }
 
     return;
 }
@@ -1,4 +1,3 @@
-
 #ifndef GCLIB_TABLE_H_
 #define GCLIB_TABLE_H_
 
@@ -9,41 +8,93 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-/* A node in a linked list containing information about an allocated memory chunk. */
+#include "gclib.h"
+#include "gclib-remset.h"
+
+/* Information about an allocated memory chunk. */
 typedef struct chunk_node
 {
-    void *ptr;
+    void *ptr;      // `NULL` once the chunk was removed from `g_chunk_table` while the node was still waiting to be swept
     size_t size;
+    uint8_t gen;
+    uint8_t age;    // number of collections of its generation the chunk survived without being promoted
     bool reachable;
-    struct chunk_node *next;
+    bool indexed;   // whether the node is in `g_chunk_index` and has yet to be swept
+    bool dead;      // whether the program freed the chunk while it was being marked incrementally or concurrently, leaving it to the sweep
+    bool pinned;    // whether a word that may not be a reference (such as one on a stack) was found pointing into the chunk during a compacting collection, which keeps it from moving
+    bool large;     // whether the chunk was mapped on its own by `large_alloc()`, which keeps it in generation 0 and in `g_large_index` instead of `g_chunk_index`
+    uint8_t site;   // index of the site the chunk was allocated from in `g_sites`, or 0 if its site isn't tracked
+    const gclib_layout *p_layout; // which words of the chunk may hold references, or `NULL` if any of them may
 } chunk_node;
 
-#define HASH_TABLE_SIZE 1024
-#define GENERATIONS 3
-#define MAX_ALLOCED_BYTES (1e+9) // maximum size of all allocations (per generation) before running the collector; 1GB may not be optimal for actual use
-extern chunk_node *g_hash_table[GENERATIONS][HASH_TABLE_SIZE];
+#define TABLE_INITIAL_SIZE 1024
+#define TABLE_NODE_BLOCK 1024 // number of `chunk_node`s allocated at a time
+#define GENERATIONS GCLIB_GENERATIONS // size of the per-generation arrays; only the first `g_generations` of them are in use
+extern chunk_node **g_chunk_table;
+extern size_t g_chunk_table_cap;
+extern size_t g_chunk_count;
+extern uint8_t g_generations;
 extern size_t g_alloced_bytes[GENERATIONS];
+extern chunk_node **g_chunk_index;
+extern const void **g_chunk_starts;
+extern size_t g_chunk_index_len;
+extern const void *g_heap_min_ptr;
+extern const void *g_heap_max_ptr;
+extern const void *g_table_min_ptr;
+extern const void *g_table_max_ptr;
+extern size_t g_table_max_size;
+extern chunk_node **g_large_index;
+extern size_t g_large_index_len;
+extern const void *g_large_min_ptr;
+extern const void *g_large_max_ptr;
+
+/* Insert a `chunk_node` containing `ptr`, `size`, `p_layout` and `large` into `g_chunk_table` as part of generation 0. Return the node, or `NULL` if there wasn't enough memory for it. */
+chunk_node *table_insert(void *ptr, size_t size, const gclib_layout *p_layout, bool large);
+
+/* Make room in `g_chunk_table` for `count` more chunks, so that inserting them never has to grow it. Return whether there was enough memory to do so. */
+bool table_reserve(size_t count);
+
+/* Remove the `chunk_node` containing `ptr` from `g_chunk_table`. Return the size of the chunk, or 0 if `ptr` isn't in `g_chunk_table`. */
+size_t table_remove(void *ptr);
+
+/* Update the `chunk_node` of the chunk at `ptr` after it was resized to `new_size` bytes and possibly moved to `new_ptr`, keeping its generation. Return its previous size, or 0 if `ptr` isn't in `g_chunk_table` (in which case nothing is updated). */
+size_t table_resize(void *ptr, void *new_ptr, size_t new_size);
 
-/* Insert a `chunk_node` containing `ptr` and `size` into `g_hash_table`. */
-void table_insert(void *ptr, size_t size);
+/* Update `*p_node`, which is in `g_chunk_table`, like `table_resize()` after its chunk was resized to `new_size` bytes and possibly moved to `new_ptr`, without looking it up again. Return its previous size. */
+size_t table_resize_node(chunk_node *p_node, void *new_ptr, size_t new_size);
 
-/* Remove all `chunk_nodes` containing `ptr` across all generations from `g_hash_table`. */
-void table_remove(void *ptr);
+/* Return the `chunk_node` of the chunk starting at `ptr`, or `NULL` if there is none. */
+chunk_node *table_lookup(const void *ptr);
 
-/* Print all entries in `g_hash_table` to `stream`. */
+/* Return the `chunk_node` `*p_node`, which is no longer in `g_chunk_table` or `g_chunk_index`, to the pool it came from. */
+void table_release_node(chunk_node *p_node);
+
+/* Move the `chunk_node` `*p_node` into generation `gen`, where it starts out with an age of 0. */
+void table_set_gen(chunk_node *p_node, uint8_t gen);
+
+/* Use `count` generations from now on, moving every chunk in a generation that is no longer in use into the oldest one that is. */
+void table_set_generations(uint8_t count);
+
+/* Print all entries in `g_chunk_table` to `stream`. */
 void table_print(FILE *stream);
 
-/* Free all `chunk_node` linked lists residing in `g_hash_table`. */
+/* Free all `chunk_node`s and the chunks they represent (leaving the regions they may lie in to `compact_free_all()`). */
 void table_free(void);
 
-/* Hash `ptr` and return an number suitable for indexing into `g_hash_table`. */
-uint16_t table_hash_ptr(const void *ptr);
+/* Rebuild `g_chunk_index` from the `chunk_node`s of the given generations and `g_large_index` from those of the large chunks, and update the bounds of both accordingly. Return whether there was enough memory to do so. */
+bool table_build_index(bool to_index[GENERATIONS]);
+
+/* Return the indexed `chunk_node` whose chunk contains the address `ptr` (which may point into its interior), or `NULL` if there is none. */
+chunk_node *table_find_chunk(const void *ptr);
+
+/* Return the `chunk_node` in `g_large_index` whose chunk contains the address `ptr` (which may point into its interior), or `NULL` if there is none. */
+chunk_node *table_find_large(const void *ptr);
 
-/* Link the `chunk_node` `*p_node` to the beginning of the linked list starting at `g_hash_table[gen][idx]`. */
-void list_link(uint8_t gen, uint16_t idx, chunk_node *p_node);
+/* Return the position in `g_chunk_index` of the last chunk starting at or below the address `ptr` (which may or may not lie within it), or `SIZE_MAX` if `ptr` lies outside of the heap bounds. Only `g_chunk_starts` is searched, so no `chunk_node` is touched. */
+size_t table_find_index(const void *ptr);
 
-/* Unlink (but do not free) the `chunk_node` `*p_node`from the linked list starting at `g_hash_table[gen][idx]`. */
-void list_unlink(uint8_t gen, uint16_t idx, chunk_node *p_node, chunk_node *p_previous);
+/* Hash `ptr` and return an number suitable for indexing into `g_chunk_table` (once reduced to its capacity). */
+size_t table_hash_ptr(const void *ptr);
 
 
 #endif  // GCLIB_TABLE_H_
@@ -0,0 +1,441 @@
+#include <string.h>
+
+#include "gclib-stats.h"
+#include "gclib-weak.h"
+
+size_t g_weak_final_len; // number of finalizers in `g_weak_final`
+
+static weak_target *g_weak_targets;   // open-addressing hash table of the chunks with finalizers or weak references, keyed by address
+static size_t g_weak_targets_cap;     // number of slots in `g_weak_targets` (always a power of two)
+static size_t g_weak_targets_count;   // number of chunks in `g_weak_targets`
+static weak_final *g_weak_final;      // finalizers of the chunks that collections found unreachable, which have yet to be run
+static size_t g_weak_final_cap;       // number of finalizers `g_weak_final` has room for
+
+static weak_target *target_get(void *ptr);
+static void target_release(size_t idx);
+static void refs_clear(weak_target *p_target);
+static bool final_append(const weak_target *p_target);
+static size_t slot_find(const void *ptr);
+static size_t slot_probe(const void *ptr);
+static void slot_delete(size_t idx);
+static bool targets_grow(void);
+
+bool weak_set_finalizer(void *ptr, gclib_finalizer finalizer, void *p_arg)
+{
+    size_t idx;
+    weak_target *p_target;
+
+    if (finalizer == NULL)
+    {
+        idx = slot_find(ptr);
+        if (idx != SIZE_MAX)
+        {
+            g_weak_targets[idx].finalizer = NULL;
+            target_release(idx);
+        }
+
+        return true;
+    }
+
+    p_target = target_get(ptr);
+    if (p_target == NULL)
+    {
+        return false;
+    }
+
+    p_target->finalizer = finalizer;
+    p_target->p_arg = p_arg;
+
+    return true;
+}
+
+gclib_weak *weak_create(void *ptr)
+{
+    gclib_weak *p_ref;
+    weak_target *p_target;
+
+    p_ref = malloc(sizeof(gclib_weak)); // memory from `malloc()` is never scanned, so the reference doesn't keep the chunk alive
+    if (p_ref == NULL)
+    {
+        return NULL;
+    }
+
+    p_target = target_get(ptr);
+    if (p_target == NULL)
+    {
+        free(p_ref);
+
+        return NULL;
+    }
+
+    p_ref->ptr = ptr;
+    p_ref->p_prev = NULL;
+    p_ref->p_next = p_target->p_refs;
+    if (p_ref->p_next != NULL)
+    {
+        p_ref->p_next->p_prev = p_ref;
+    }
+
+    p_target->p_refs = p_ref;
+
+    return p_ref;
+}
+
+void weak_destroy(gclib_weak *p_ref)
+{
+    size_t idx;
+
+    if (p_ref->ptr == NULL) // already unlinked when its chunk went away
+    {
+        return;
+    }
+
+    idx = slot_find(p_ref->ptr);
+    if (p_ref->p_prev != NULL)
+    {
+        p_ref->p_prev->p_next = p_ref->p_next;
+    }
+    else if (idx != SIZE_MAX)
+    {
+        g_weak_targets[idx].p_refs = p_ref->p_next;
+    }
+
+    if (p_ref->p_next != NULL)
+    {
+        p_ref->p_next->p_prev = p_ref->p_prev;
+    }
+
+    p_ref->ptr = NULL;
+    if (idx != SIZE_MAX)
+    {
+        target_release(idx);
+    }
+
+    return;
+}
+
+void weak_forget(const void *ptr)
+{
+    size_t idx;
+
+    if (g_weak_targets_count == 0) // the common case, which every free goes through
+    {
+        return;
+    }
+
+    idx = slot_find(ptr);
+    if (idx == SIZE_MAX)
+    {
+        return;
+    }
+
+    refs_clear(&g_weak_targets[idx]);
+    slot_delete(idx);
+
+    return;
+}
+
+void weak_move(const void *ptr, void *new_ptr)
+{
+    size_t idx;
+    weak_target target;
+    gclib_weak *p_ref;
+
+    if (g_weak_targets_count == 0)
+    {
+        return;
+    }
+
+    idx = slot_find(ptr);
+    if (idx == SIZE_MAX)
+    {
+        return;
+    }
+
+    // Rehash the chunk under its new address, which can't need the table to grow since the count doesn't change. This
+    // may be done by a compacting collection while the other threads are stopped, so it mustn't allocate either.
+    target = g_weak_targets[idx];
+    slot_delete(idx);
+    target.ptr = new_ptr;
+    g_weak_targets[slot_probe(new_ptr)] = target;
+    g_weak_targets_count++;
+
+    for (p_ref = target.p_refs; p_ref != NULL; p_ref = p_ref->p_next)
+    {
+        p_ref->ptr = new_ptr;
+    }
+
+    return;
+}
+
+size_t weak_push_pending(mark_stack *p_stack)
+{
+    size_t idx;
+
+    // The words are scanned as if they may not be references so that compacting collections don't move the chunks,
+    // since nothing rewrites the queue
+    for (idx = 0; idx < g_weak_final_len; idx++)
+    {
+        collector_scan(p_stack, (const void **) &g_weak_final[idx].ptr, (const void **) &g_weak_final[idx].ptr + 1, MARK_UNTRACKED, NULL);
+    }
+
+    return g_weak_final_len;
+}
+
+void weak_reserve(void)
+{
+    size_t new_cap;
+    weak_final *p_new_final;
+
+    // Every watched chunk might turn out to be unreachable, and `weak_process()` can't grow the queue itself
+    new_cap = (g_weak_final_cap == 0) ? WEAK_FINAL_INITIAL_SIZE : g_weak_final_cap;
+    while (new_cap < g_weak_final_len + g_weak_targets_count)
+    {
+        new_cap *= 2;
+    }
+
+    if (new_cap == g_weak_final_cap)
+    {
+        return;
+    }
+
+    p_new_final = realloc(g_weak_final, new_cap * sizeof(weak_final));
+    if (p_new_final == NULL) // the chunks that don't fit are queued by a later collection
+    {
+        return;
+    }
+
+    g_weak_final = p_new_final;
+    g_weak_final_cap = new_cap;
+
+    return;
+}
+
+bool weak_process(mark_stack *p_stack)
+{
+    size_t idx;
+    bool queued;
+    weak_target *p_target;
+
+    // Weak references are cleared even when their chunk is kept alive for its finalizer, which may be run at any
+    // time from now on. Deleting an entry shifts the one after it (if any) into its slot, which is looked at next.
+    queued = false;
+    idx = 0;
+    while (idx < g_weak_targets_cap)
+    {
+        p_target = &g_weak_targets[idx];
+        if (p_target->ptr == NULL || collector_survives(p_target->ptr))
+        {
+            idx++;
+
+            continue;
+        }
+
+        refs_clear(p_target);
+        if (p_target->finalizer != NULL)
+        {
+            queued = true;
+
+            if (!final_append(p_target)) // keep the chunk alive and registered until a later collection finds room to queue it
+            {
+                collector_scan(p_stack, (const void **) &p_target->ptr, (const void **) &p_target->ptr + 1, MARK_UNTRACKED, NULL);
+                idx++;
+
+                continue;
+            }
+
+            // Everything the chunk references has to survive along with it for the finalizer to be able to use it
+            collector_scan(p_stack, (const void **) &g_weak_final[g_weak_final_len - 1].ptr, (const void **) &g_weak_final[g_weak_final_len - 1].ptr + 1, MARK_UNTRACKED, NULL);
+            g_stats.finalized_chunks++;
+        }
+
+        slot_delete(idx);
+    }
+
+    return queued;
+}
+
+size_t weak_take_pending(weak_final *p_batch, size_t max)
+{
+    size_t count;
+
+    // Finalizers aren't run in any particular order, so take them from the end where nothing has to move
+    count = (g_weak_final_len < max) ? g_weak_final_len : max;
+    g_weak_final_len -= count;
+    memcpy(p_batch, g_weak_final + g_weak_final_len, count * sizeof(weak_final));
+
+    return count;
+}
+
+void weak_free_all(void)
+{
+    size_t idx;
+
+    for (idx = 0; idx < g_weak_targets_cap; idx++)
+    {
+        if (g_weak_targets[idx].ptr != NULL)
+        {
+            refs_clear(&g_weak_targets[idx]);
+        }
+    }
+
+    free(g_weak_targets);
+    g_weak_targets = NULL;
+    g_weak_targets_cap = g_weak_targets_count = 0;
+
+    free(g_weak_final); // finalizers that are still waiting are never run
+    g_weak_final = NULL;
+    g_weak_final_len = g_weak_final_cap = 0;
+
+    return;
+}
+
+static weak_target *target_get(void *ptr)
+{
+    size_t idx;
+
+    idx = slot_find(ptr);
+    if (idx != SIZE_MAX)
+    {
+        return &g_weak_targets[idx];
+    }
+
+    if (g_weak_targets_count + 1 > g_weak_targets_cap / 2 && !targets_grow()) // keep the load factor at or below one half
+    {
+        return NULL;
+    }
+
+    idx = slot_probe(ptr);
+    g_weak_targets[idx].ptr = ptr;
+    g_weak_targets[idx].finalizer = NULL;
+    g_weak_targets[idx].p_arg = NULL;
+    g_weak_targets[idx].p_refs = NULL;
+    g_weak_targets_count++;
+
+    return &g_weak_targets[idx];
+}
+
+static void target_release(size_t idx)
+{
+    if (g_weak_targets[idx].finalizer == NULL && g_weak_targets[idx].p_refs == NULL) // nothing left to watch the chunk for
+    {
+        slot_delete(idx);
+    }
+
+    return;
+}
+
+static void refs_clear(weak_target *p_target)
+{
+    gclib_weak *p_ref, *p_next;
+
+    for (p_ref = p_target->p_refs; p_ref != NULL; p_ref = p_next)
+    {
+        p_next = p_ref->p_next;
+        p_ref->ptr = NULL;
+        p_ref->p_prev = p_ref->p_next = NULL;
+        g_stats.cleared_weak_refs++;
+    }
+
+    p_target->p_refs = NULL;
+
+    return;
+}
+
+static bool final_append(const weak_target *p_target)
+{
+    if (g_weak_final_len == g_weak_final_cap) // room is only made by `weak_reserve()`, before the other threads are stopped
+    {
+        return false;
+    }
+
+    g_weak_final[g_weak_final_len].ptr = p_target->ptr;
+    g_weak_final[g_weak_final_len].finalizer = p_target->finalizer;
+    g_weak_final[g_weak_final_len].p_arg = p_target->p_arg;
+    g_weak_final_len++;
+
+    return true;
+}
+
+static size_t slot_find(const void *ptr)
+{
+    size_t idx;
+
+    if (g_weak_targets_cap == 0)
+    {
+        return SIZE_MAX;
+    }
+
+    for (idx = table_hash_ptr(ptr) & (g_weak_targets_cap - 1); g_weak_targets[idx].ptr != NULL; idx = (idx + 1) & (g_weak_targets_cap - 1))
+    {
+        if (g_weak_targets[idx].ptr == ptr)
+        {
+            return idx;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+static size_t slot_probe(const void *ptr)
+{
+    size_t idx;
+
+    // Linear probing for the first empty slot; `ptr` must not already be present
+    for (idx = table_hash_ptr(ptr) & (g_weak_targets_cap - 1); g_weak_targets[idx].ptr != NULL; idx = (idx + 1) & (g_weak_targets_cap - 1))
+        ;
+
+    return idx;
+}
+
+static void slot_delete(size_t idx)
+{
+    size_t next, home, mask;
+
+    // Backward-shift deletion, as for `g_chunk_table`
+    mask = g_weak_targets_cap - 1;
+    for (next = (idx + 1) & mask; g_weak_targets[next].ptr != NULL; next = (next + 1) & mask)
+    {
+        home = table_hash_ptr(g_weak_targets[next].ptr) & mask;
+        if (((next - home) & mask) >= ((next - idx) & mask))
+        {
+            g_weak_targets[idx] = g_weak_targets[next];
+            idx = next;
+        }
+    }
+
+    g_weak_targets[idx].ptr = NULL;
+    g_weak_targets_count--;
+
+    return;
+}
+
+static bool targets_grow(void)
+{
+    size_t idx, new_idx, new_cap;
+    weak_target *p_new;
+
+    new_cap = (g_weak_targets_cap == 0) ? WEAK_TABLE_INITIAL_SIZE : 2 * g_weak_targets_cap;
+    p_new = calloc(new_cap, sizeof(weak_target));
+    if (p_new == NULL)
+    {
+        return false;
+    }
+
+    for (idx = 0; idx < g_weak_targets_cap; idx++)
+    {
+        if (g_weak_targets[idx].ptr != NULL)
+        {
+            for (new_idx = table_hash_ptr(g_weak_targets[idx].ptr) & (new_cap - 1); p_new[new_idx].ptr != NULL; new_idx = (new_idx + 1) & (new_cap - 1))
+                ;
+
+            p_new[new_idx] = g_weak_targets[idx];
+        }
+    }
+
+    free(g_weak_targets);
+    g_weak_targets = p_new;
+    g_weak_targets_cap = new_cap;
+
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef GCLIB_WEAK_H
+#define GCLIB_WEAK_H
+
+
+#include "gclib-collector.h"
+
+/* A chunk that the collector watches without keeping it alive, because it has a finalizer or weak references to it. */
+typedef struct weak_target
+{
+    void *ptr;                 // `NULL` for an empty slot of `g_weak_targets`
+    gclib_finalizer finalizer; // `NULL` if the chunk only has weak references
+    void *p_arg;
+    gclib_weak *p_refs;        // weak references to the chunk, linked through `p_next`
+} weak_target;
+
+/* A weak reference handed out by `gclib_weak_create()`. */
+struct gclib_weak
+{
+    void *ptr; // `NULL` once the chunk was collected or freed
+    gclib_weak *p_prev;
+    gclib_weak *p_next;
+};
+
+/* A finalizer that is waiting to be run for the chunk it was registered for, which collections keep alive until then. */
+typedef struct weak_final
+{
+    void *ptr;
+    gclib_finalizer finalizer;
+    void *p_arg;
+} weak_final;
+
+#define WEAK_TABLE_INITIAL_SIZE 64
+#define WEAK_FINAL_INITIAL_SIZE 64
+#define WEAK_FINAL_BATCH 64 // number of finalizers run at a time, which is all an allocation runs before returning
+
+extern size_t g_weak_final_len;
+
+/* Set the finalizer of the chunk at `ptr` (replacing any previous one), or remove it if `finalizer` is `NULL`. Return whether there was enough memory to do so. */
+bool weak_set_finalizer(void *ptr, gclib_finalizer finalizer, void *p_arg);
+
+/* Return a new weak reference to the chunk at `ptr`, or `NULL` if there wasn't enough memory. */
+gclib_weak *weak_create(void *ptr);
+
+/* Unlink the weak reference `*p_ref` from the chunk it references, if any. */
+void weak_destroy(gclib_weak *p_ref);
+
+/* Forget about the chunk at `ptr`, which the program freed: clear the weak references to it and drop its finalizer. */
+void weak_forget(const void *ptr);
+
+/* Follow the chunk at `ptr` to `new_ptr`, where it was moved. */
+void weak_move(const void *ptr, void *new_ptr);
+
+/* Scan the chunks whose finalizers are waiting to be run onto `*p_stack` as roots. Return the number of words scanned. */
+size_t weak_push_pending(mark_stack *p_stack);
+
+/* Make room in the queue of finalizers waiting to be run for every watched chunk, so that `weak_process()` doesn't have to allocate while the other threads are stopped. */
+void weak_reserve(void);
+
+/* Clear the weak references to the chunks that the collection that just finished marking found unreachable, and queue the finalizers of those that have one, scanning them onto `*p_stack` so that they survive until their finalizers have run. Return whether any were queued. */
+bool weak_process(mark_stack *p_stack);
+
+/* Move up to `max` of the finalizers waiting to be run into `p_batch`. Return the number moved. */
+size_t weak_take_pending(weak_final *p_batch, size_t max);
+
+/* Free the memory used to track finalizers and weak references, leaving the weak references themselves to the program. */
+void weak_free_all(void);
+
+
+#endif // GCLIB_WEAK_H
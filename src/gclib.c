@@ -1,14 +1,39 @@
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "gclib.h"
 #include "gclib-collector.h"
+#include "gclib-compact.h"
+#include "gclib-dirty.h"
+#include "gclib-large.h"
+#include "gclib-marker.h"
+#include "gclib-memory.h"
+#include "gclib-mutator.h"
+#include "gclib-region.h"
+#include "gclib-site.h"
+#include "gclib-stats.h"
+#include "gclib-weak.h"
 
 extern char etext, edata, end; // end of text segment, initialized data segment, and BSS; all provided by the linker; https://linux.die.net/man/3/etext
 
 static bool g_init = false;
 static bool g_cleanup = false;
+static const gclib_layout g_atomic_layout = { sizeof(void *), NULL }; // shared by every chunk allocated through `gclib_alloc_atomic()`
+static pthread_mutex_t g_gclib_lock = PTHREAD_MUTEX_INITIALIZER;      // held by every public function except for allocations served from a thread's own slab pages
+static __thread bool g_finalizing;                                    // whether the calling thread is running finalizers, which may allocate in turn
+
+static void *layout_alloc(size_t size, bool zeroed, const gclib_layout *p_layout, uintptr_t site);
+static size_t batch_alloc(size_t count, size_t size, const size_t *p_sizes, bool zeroed, void **p_out, uintptr_t site);
+static void alloc_pace(void);
+static void *chunk_alloc(size_t size, bool zeroed, const gclib_layout *p_layout, uintptr_t site);
+static void *chunk_realloc(void *ptr, size_t new_size);
+static void *chunk_copy_alloc(const chunk_node *p_node, size_t new_size);
+static bool chunk_is_start(const void *ptr);
+static bool chunk_contains(const void *ptr);
+static void finalizers_run(bool all);
 
 void gclib_init(void)
 {
@@ -17,12 +42,20 @@ void gclib_init(void)
         return;
     }
 
-    // Getting pointers to the stack and data segments like this is hackish but there seems to be no better way.
+    // Getting pointers to the data segment like this is hackish but there seems to be no better way.
     // Not to mention that this likely only works on x86-64 Linux AND when complied with GCC.
-    g_stack_end_ptr = (const void **) __builtin_frame_address(1); // address of stack frame of caller of `gclib_init()` (should be `main()`); https://gcc.gnu.org/onlinedocs/gcc/Return-Address.html#index-_005f_005fbuiltin_005fframe_005faddress
     g_data_start_ptr = (const void **) &etext;
     g_data_end_ptr = (const void **) &end;
 
+    collector_init();
+
+    // The thread that initializes `gclib` is always registered. Its whole stack is scanned (rather than just up to the
+    // frame of `main()`, which can't be found reliably without frame pointers) just like that of any other thread.
+    if (!mutator_init() || mutator_register(NULL) == NULL)
+    {
+        return;
+    }
+
     g_init = true;
 
     return;
@@ -35,10 +68,28 @@ void gclib_cleanup(void)
         return;
     }
 
+    pthread_mutex_lock(&g_gclib_lock);
+
+    marker_background_stop();
+    marker_stop();
+    mutator_free();
     table_free();
+    compact_free_all();
+    large_free_all();
+    slab_free_all();
+    collector_free();
+    remset_free();
+    dirty_free();
+    stats_free();
+    memory_free();
+    weak_free_all();
+    region_free_all();
+    site_free_all();
 
     g_cleanup = true;
 
+    pthread_mutex_unlock(&g_gclib_lock);
+
     return;
 }
 
@@ -47,159 +98,1094 @@ bool gclib_ready(void)
     return g_init && !g_cleanup;
 }
 
+bool gclib_register_thread(void)
+{
+    bool registered;
+
+    if (!gclib_ready())
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    registered = mutator_register(NULL) != NULL;
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return registered;
+}
+
+void gclib_unregister_thread(void)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_merge_barriers();
+    mutator_unregister();
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
 void *gclib_alloc(size_t size, bool zeroed)
 {
-    void *ptr;
+    return layout_alloc(size, zeroed, NULL, (uintptr_t) __builtin_return_address(0));
+}
+
+void *gclib_alloc_atomic(size_t size, bool zeroed)
+{
+    return layout_alloc(size, zeroed, &g_atomic_layout, (uintptr_t) __builtin_return_address(0));
+}
+
+void *gclib_alloc_typed(size_t size, bool zeroed, const gclib_layout *p_layout)
+{
+    if (p_layout != NULL && p_layout->size < sizeof(void *)) // no words to describe, so scan the chunk as a whole
+    {
+        p_layout = NULL;
+    }
+
+    return layout_alloc(size, zeroed, p_layout, (uintptr_t) __builtin_return_address(0));
+}
+
+size_t gclib_alloc_batch(size_t count, size_t size, bool zeroed, void **p_out)
+{
+    return batch_alloc(count, size, NULL, zeroed, p_out, (uintptr_t) __builtin_return_address(0));
+}
+
+size_t gclib_alloc_batch_sizes(size_t count, const size_t *p_sizes, bool zeroed, void **p_out)
+{
+    return batch_alloc(count, 0, p_sizes, zeroed, p_out, (uintptr_t) __builtin_return_address(0));
+}
+
+void *gclib_alloc_site(size_t size, bool zeroed, uintptr_t site)
+{
+    return layout_alloc(size, zeroed, NULL, site);
+}
+
+void *gclib_realloc(void *ptr, size_t new_size)
+{
+    void *new_ptr;
 
     if (!gclib_ready())
     {
         return NULL;
     }
 
-    collector_run(false);
+    pthread_mutex_lock(&g_gclib_lock);
+    new_ptr = chunk_realloc(ptr, new_size);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    finalizers_run(false);
+
+    return new_ptr;
+}
 
-    if (zeroed)
+void gclib_free(void *ptr)
+{
+    if (!gclib_ready())
     {
-        ptr = calloc(1, size);
+        return;
     }
-    else
+
+    pthread_mutex_lock(&g_gclib_lock);
+
+    if (slab_find_page(ptr) != NULL)
     {
-        ptr = malloc(size);
+        slab_free(ptr);
+    }
+    else if (!collector_defer_free(ptr))
+    {
+        collector_merge_barriers(); // so that the words of the chunk are forgotten instead of being remembered after it is gone
+        compact_free(ptr, (ptr != NULL) ? table_remove(ptr) : 0); // `gclib_alloc()` and `gclib_realloc()` don't add null-pointers to the hash table
     }
 
-    // Handle any errors from `malloc()`/`calloc()`
-    if (ptr == NULL && size != 0)
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_write_ptr(void *dst, void *val)
+{
+    remset_buffer *p_buffer;
+
+    if (val == NULL || !gclib_ready())
     {
-        collector_run(true); // likely not to improve the situation but not much else we can do
+        *(void **) dst = val;
 
-        if (zeroed)
-        {
-            ptr = calloc(1, size);
-        }
-        else
-        {
-            ptr = malloc(size);
-        }
+        return;
+    }
 
-        if (ptr == NULL)
+    // Fast path: a registered thread remembers the word in a buffer of its own, which is added to the remembered set
+    // by the next pause (or by whoever takes the lock to free or move a chunk). A collection that stops the thread
+    // between the store and the buffer finds `dst` and `val` in its registers, which keeps both chunks alive and in
+    // place until the word is remembered. Only an incremental collection needs the reference shaded right away.
+    p_buffer = (g_mutator_self != NULL) ? &g_mutator_self->barrier : NULL;
+    if (p_buffer != NULL && (!__atomic_load_n(&g_mark_active, __ATOMIC_RELAXED) || __atomic_load_n(&g_mark_background, __ATOMIC_RELAXED)))
+    {
+        if (p_buffer->len == REMSET_BUFFER_WORDS)
         {
-            return NULL;
+            pthread_mutex_lock(&g_gclib_lock);
+            collector_merge_barriers();
+            p_buffer->len = p_buffer->merged = 0;
+            pthread_mutex_unlock(&g_gclib_lock);
         }
+
+        *(void **) dst = val;
+        p_buffer->words[p_buffer->len] = dst;
+        __atomic_store_n(&p_buffer->len, p_buffer->len + 1, __ATOMIC_RELEASE);
+        __asm__ volatile ("" : : "r" (dst), "r" (val) : "memory");
+
+        return;
     }
 
-    if (size == 0)
+    // Store while holding the lock so that a collection never sees the new reference without it being remembered
+    pthread_mutex_lock(&g_gclib_lock);
+    *(void **) dst = val;
+    remset_add(dst); // whether this actually creates a reference from an older chunk to a younger one is sorted out during collection
+    collector_shade((const void **) dst, (const void **) dst + 1, NULL); // the chunk containing `dst` may already have been scanned
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+bool gclib_add_root(void *ptr, size_t size)
+{
+    bool added;
+
+    if (!gclib_ready() || ptr == NULL)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    added = collector_add_root((const void **) ptr, (const void **) (ptr + size));
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return added;
+}
+
+void gclib_remove_root(void *ptr)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_remove_root((const void **) ptr);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+bool gclib_register_finalizer(void *ptr, gclib_finalizer finalizer, void *p_arg)
+{
+    bool registered;
+
+    if (!gclib_ready())
     {
-        free(ptr); // `malloc()`/`calloc()` may not always return `NULL` in this case
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    registered = chunk_is_start(ptr) && weak_set_finalizer(ptr, finalizer, p_arg);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return registered;
+}
+
+gclib_weak *gclib_weak_create(void *ptr)
+{
+    gclib_weak *p_weak;
+
+    if (!gclib_ready())
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    p_weak = chunk_is_start(ptr) ? weak_create(ptr) : NULL;
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return p_weak;
+}
+
+void *gclib_weak_get(const gclib_weak *p_weak)
+{
+    void *ptr;
 
+    if (!gclib_ready() || p_weak == NULL)
+    {
         return NULL;
     }
 
-    table_insert(ptr, size);
+    // Once the reference is on the calling thread's stack, the final pause of a collection that is under way finds
+    // it there, so no barrier is needed to keep the chunk from being cleared
+    pthread_mutex_lock(&g_gclib_lock);
+    ptr = p_weak->ptr;
+    pthread_mutex_unlock(&g_gclib_lock);
 
     return ptr;
 }
 
-void *gclib_realloc(void *ptr, size_t new_size)
+void gclib_weak_free(gclib_weak *p_weak)
 {
-    void *new_ptr;
+    if (p_weak == NULL)
+    {
+        return;
+    }
+
+    if (gclib_ready()) // otherwise, `gclib_cleanup()` already unlinked it
+    {
+        pthread_mutex_lock(&g_gclib_lock);
+        weak_destroy(p_weak);
+        pthread_mutex_unlock(&g_gclib_lock);
+    }
+
+    free(p_weak);
+
+    return;
+}
+
+gclib_region *gclib_region_create(bool scanned)
+{
+    gclib_region *p_region;
 
     if (!gclib_ready())
     {
         return NULL;
     }
 
-    collector_run(false);
+    pthread_mutex_lock(&g_gclib_lock);
+    p_region = region_create(scanned);
+    pthread_mutex_unlock(&g_gclib_lock);
 
-    new_ptr = realloc(ptr, new_size);
+    return p_region;
+}
 
-    // Handle any errors from `realloc()`
-    if (new_ptr == NULL && new_size != 0) // if `new_size` is zero, `realloc()` returning `NULL` is actually the intended effect
+void *gclib_region_alloc(gclib_region *p_region, size_t size, bool zeroed)
+{
+    void *ptr;
+
+    if (!gclib_ready() || p_region == NULL || size == 0)
     {
-        collector_run(true); // likely not to improve the situation but not much else we can do
+        return NULL;
+    }
 
-        new_ptr = realloc(ptr, new_size);
-        if (new_ptr == NULL)
-        {
-            return NULL;
-        }
+    // Only the thread that allocates from the region changes the current block, and collections stop it before
+    // looking at the block, so just adding a new block needs the lock
+    ptr = region_alloc(p_region, size);
+    if (ptr == NULL)
+    {
+        pthread_mutex_lock(&g_gclib_lock);
+        ptr = region_refill(p_region, size);
+        pthread_mutex_unlock(&g_gclib_lock);
     }
 
-    if (ptr == NULL) // `realloc(NULL, new_size)` acts as `malloc(new_size)`
+    if (ptr != NULL && zeroed)
     {
-        if (new_size == 0)
-        {
-            free(new_ptr); // `realloc()` may not always return `NULL` in this case
+        memset(ptr, 0, size);
+    }
 
-            return NULL;
-        }
+    return ptr;
+}
 
-        table_insert(new_ptr, new_size);
+void gclib_region_destroy(gclib_region *p_region)
+{
+    if (p_region == NULL)
+    {
+        return;
+    }
 
-        return new_ptr;
+    if (gclib_ready()) // otherwise, `gclib_cleanup()` already unlinked it
+    {
+        pthread_mutex_lock(&g_gclib_lock);
+        region_unlink(p_region);
+        collector_merge_barriers(); // so that the words `gclib_write_ptr()` stored into the region are forgotten instead of being remembered after it is gone
+        collector_merge_remembered();
+        region_forget(p_region);
+        pthread_mutex_unlock(&g_gclib_lock);
     }
 
-    if (new_size == 0) // `realloc(ptr, 0)` acts as `free(ptr)` and returns `NULL`
+    region_free(p_region);
+
+    return;
+}
+
+void gclib_set_data_scan(bool enabled)
+{
+    if (!gclib_ready())
     {
-        table_remove(ptr);
+        return;
+    }
 
-        return NULL;
+    pthread_mutex_lock(&g_gclib_lock);
+    g_scan_data = enabled;
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_pause_target(unsigned int microseconds)
+{
+    if (!gclib_ready())
+    {
+        return;
     }
 
-    table_remove(ptr);               // `realloc()` returns the same pointer passed to it after resizing if possible,
-    table_insert(new_ptr, new_size); // which means the removal and insertion is inefficient
+    pthread_mutex_lock(&g_gclib_lock);
+    g_pause_target = microseconds;
+    pthread_mutex_unlock(&g_gclib_lock);
 
-    return new_ptr;
+    return;
 }
 
-void gclib_free(void *ptr)
+bool gclib_set_concurrent(bool enabled)
+{
+    if (!gclib_ready())
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+
+    if (enabled)
+    {
+        dirty_init(); // without soft-dirty bits, every page counts as written to
+        g_concurrent = marker_background_start();
+    }
+    else // a collection the thread was working on is finished by the next allocation
+    {
+        marker_background_stop();
+        g_concurrent = false;
+    }
+
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return g_concurrent == enabled;
+}
+
+void gclib_set_slab_alloc(bool enabled)
 {
     if (!gclib_ready())
     {
         return;
     }
 
-    free(ptr);
+    pthread_mutex_lock(&g_gclib_lock);
+    g_slab_enabled = enabled;
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
 
-    if (ptr != NULL) // `gclib_alloc()` and `gclib_realloc()` don't add null-pointers to the hash table
+void gclib_set_large_threshold(size_t bytes)
+{
+    if (!gclib_ready())
     {
-        table_remove(ptr);
+        return;
     }
 
+    pthread_mutex_lock(&g_gclib_lock);
+    g_large_threshold = bytes; // chunks that were already allocated stay where they are
+    pthread_mutex_unlock(&g_gclib_lock);
+
     return;
 }
 
-void gclib_collect(void)
+void gclib_set_compaction(bool enabled)
 {
     if (!gclib_ready())
     {
         return;
     }
 
-    collector_run(false);
+    pthread_mutex_lock(&g_gclib_lock);
+    g_compact_enabled = enabled;
+    pthread_mutex_unlock(&g_gclib_lock);
 
     return;
 }
 
-void gclib_force_collect(void)
+void gclib_set_gen_budget(unsigned int gen, size_t bytes)
+{
+    if (!gclib_ready() || gen >= GENERATIONS)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_set_budget(gen, bytes);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_generations(unsigned int count)
+{
+    if (!gclib_ready() || count == 0 || count > GENERATIONS)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_set_generations(count);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_tenure_age(unsigned int collections)
+{
+    if (!gclib_ready() || collections == 0 || collections > UINT8_MAX)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_set_tenure_age(collections);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_pretenuring(bool enabled)
 {
     if (!gclib_ready())
     {
         return;
     }
 
-    collector_run(true);
+    pthread_mutex_lock(&g_gclib_lock);
+    g_site_tracking = enabled; // chunks that were already allocated keep counting towards their sites' survival rates
+    pthread_mutex_unlock(&g_gclib_lock);
 
     return;
 }
 
-void gclib_print_leaks(FILE *stream)
+void gclib_set_growth_percent(unsigned int percent)
 {
     if (!gclib_ready())
     {
         return;
     }
 
-    table_print(stream);
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_set_growth(percent);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_heap_limit(size_t bytes)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_set_limit(bytes);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+bool gclib_set_mark_threads(unsigned int threads)
+{
+    bool started;
+
+    if (!gclib_ready())
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+
+    started = true;
+    if (threads <= 1)
+    {
+        marker_stop();
+    }
+    else
+    {
+        started = marker_start(threads); // on failure, the helpers that were started are stopped again
+    }
+
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return started;
+}
+
+void gclib_get_stats(gclib_stats *p_stats)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    *p_stats = g_stats;
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_reset_pause_stats(void)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    stats_reset_pauses();
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_set_cycle_callback(gclib_cycle_callback callback, void *p_arg)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    stats_set_callback(callback, p_arg);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+void gclib_collect(void)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_run(false);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    finalizers_run(true);
+
+    return;
+}
+
+void gclib_force_collect(void)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_run(true);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    finalizers_run(true);
+
+    return;
+}
+
+void gclib_print_leaks(FILE *stream)
+{
+    if (!gclib_ready())
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+    collector_sweep_finish(); // chunks that are already known to be unreachable aren't leaks
+    table_print(stream);
+    slab_print(stream);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    return;
+}
+
+static void *layout_alloc(size_t size, bool zeroed, const gclib_layout *p_layout, uintptr_t site)
+{
+    void *ptr;
+
+    if (!gclib_ready())
+    {
+        return NULL;
+    }
+
+    // Fast path: a registered thread takes the next object reserved in its own page without locking anything. Reading
+    // the pacing state without the lock may let an allocation or two through late, which the next one makes up for.
+    // Only a collection marking on the background thread leaves the program alone until it is done.
+    if (g_mutator_self != NULL && __atomic_load_n(&g_slab_enabled, __ATOMIC_RELAXED) && 0 < size && size <= SLAB_MAX_SIZE && (p_layout == NULL || p_layout == &g_atomic_layout)
+        && __atomic_load_n(&g_alloc_debt, __ATOMIC_RELAXED) < __atomic_load_n(&g_collect_trigger, __ATOMIC_RELAXED) && !__atomic_load_n(&g_sweep_pending, __ATOMIC_RELAXED)
+        && (!__atomic_load_n(&g_mark_active, __ATOMIC_RELAXED) || __atomic_load_n(&g_mark_background, __ATOMIC_RELAXED)))
+    {
+        ptr = slab_tlab_alloc(g_mutator_self->p_tlabs[p_layout != NULL][slab_size_class(size)], zeroed);
+        if (ptr != NULL)
+        {
+            return ptr;
+        }
+    }
+
+    pthread_mutex_lock(&g_gclib_lock);
+
+    alloc_pace();
+
+    if (size == 0)
+    {
+        pthread_mutex_unlock(&g_gclib_lock);
+
+        return NULL;
+    }
+
+    ptr = chunk_alloc(size, zeroed, p_layout, site);
+
+    // Handle any errors from `malloc()`/`calloc()`/`slab_alloc()`
+    if (ptr == NULL)
+    {
+        collector_run(true); // likely not to improve the situation but not much else we can do
+
+        ptr = chunk_alloc(size, zeroed, p_layout, site);
+    }
+
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    finalizers_run(false);
+
+    return ptr;
+}
+
+static size_t batch_alloc(size_t count, size_t size, const size_t *p_sizes, bool zeroed, void **p_out, uintptr_t site)
+{
+    size_t idx;
+    void *ptr;
+
+    if (!gclib_ready())
+    {
+        return 0;
+    }
+
+    // The whole batch is paced as one allocation and the table grows at most once for it, which leaves little more
+    // than getting the memory itself for each chunk
+    pthread_mutex_lock(&g_gclib_lock);
+    alloc_pace();
+    table_reserve(count); // without the room, the chunks are still inserted one at a time
+
+    for (idx = 0; idx < count; idx++)
+    {
+        if (p_sizes != NULL)
+        {
+            size = p_sizes[idx];
+        }
+
+        ptr = (size > 0) ? chunk_alloc(size, zeroed, NULL, site) : NULL;
+        if (ptr == NULL && size > 0)
+        {
+            // `p_out` may be memory that isn't scanned, so the chunks allocated so far are only kept alive by
+            // registering the entries holding them for as long as the collection takes. Without the memory to do so,
+            // there is no collecting without freeing them.
+            if (idx > 0 && !collector_add_root((const void **) p_out, (const void **) (p_out + idx)))
+            {
+                break;
+            }
+
+            collector_run(true); // likely not to improve the situation but not much else we can do
+            if (idx > 0)
+            {
+                collector_remove_root((const void **) p_out);
+            }
+
+            ptr = chunk_alloc(size, zeroed, NULL, site);
+            if (ptr == NULL)
+            {
+                break; // leaving the entry for this chunk and those after it untouched
+            }
+        }
+
+        p_out[idx] = ptr;
+    }
+
+    // As if each chunk was stored with `gclib_write_ptr()`, since `p_out` may be in a chunk of an older generation or one
+    // an incremental collection already scanned. Anywhere else, it is either scanned as a root or not scanned at all, and
+    // remembering it would only have later collections read it after the program freed it.
+    if (chunk_contains(p_out))
+    {
+        remset_add_range(p_out, idx * sizeof(void *));
+    }
+
+    collector_shade((const void **) p_out, (const void **) (p_out + idx), NULL);
+    pthread_mutex_unlock(&g_gclib_lock);
+
+    finalizers_run(false);
+
+    return idx;
+}
+
+static void alloc_pace(void)
+{
+    if (g_mark_active && g_alloc_debt < g_collect_trigger) // keep the incremental collection ahead of the program, or finish a concurrent one the background thread is done with
+    {
+        collector_mark_step();
+    }
+    else if (g_alloc_debt >= g_collect_trigger) // also finishes an incremental collection that fell too far behind
+    {
+        collector_run(false);
+    }
+    else if (g_sweep_pending) // pay off a bit of the last collection's sweep instead
+    {
+        collector_sweep_step(SWEEP_STEP_CHUNKS);
+    }
+
+    return;
+}
+
+static void *chunk_alloc(size_t size, bool zeroed, const gclib_layout *p_layout, uintptr_t site)
+{
+    void *ptr;
+    bool large;
+    slab_page **pp_tlab;
+    chunk_node *p_node;
+
+    if (g_slab_enabled && size <= SLAB_MAX_SIZE && (p_layout == NULL || p_layout == &g_atomic_layout)) // pages have no room for per-object layouts
+    {
+        if (g_mutator_self != NULL) // registered threads allocate from their own pages, whose whole free space counts towards the debt once taken
+        {
+            pp_tlab = &g_mutator_self->p_tlabs[p_layout != NULL][slab_size_class(size)];
+            ptr = slab_tlab_alloc(*pp_tlab, zeroed);
+            if (ptr == NULL)
+            {
+                g_alloc_debt += slab_tlab_refill(pp_tlab, slab_size_class(size), p_layout != NULL);
+                ptr = slab_tlab_alloc(*pp_tlab, zeroed);
+            }
+
+            return ptr;
+        }
+
+        ptr = slab_alloc(size, zeroed, p_layout != NULL); // slab objects need no `chunk_node`
+        if (ptr != NULL)
+        {
+            g_alloc_debt += size;
+        }
+
+        return ptr;
+    }
+
+    large = g_large_threshold > 0 && size >= g_large_threshold;
+    if (large) // mapped on its own so that freeing it gives the pages straight back
+    {
+        ptr = large_alloc(size, zeroed);
+    }
+    else if (zeroed)
+    {
+        ptr = calloc(1, size);
+    }
+    else
+    {
+        ptr = malloc(size);
+    }
+
+    if (ptr == NULL)
+    {
+        return NULL;
+    }
+
+    p_node = table_insert(ptr, size, p_layout, large);
+    if (p_node != NULL)
+    {
+        p_node->site = (g_site_tracking && !large) ? site_lookup(site) : 0;
+
+        // Chunks from a site whose chunks mostly survive skip the younger generations, where they would only be marked
+        // and promoted. Collections still scan them for as long as they would have been traced in generation 0, since
+        // they are likely to be initialized with references to younger chunks without `gclib_write_ptr()`.
+        if (p_node->site != 0 && g_generations > 1 && site_pretenure(p_node->site) && collector_note_pretenured(ptr))
+        {
+            table_set_gen(p_node, g_generations - 1);
+            g_stats.pretenured_chunks++;
+            g_stats.pretenured_bytes += size;
+        }
+    }
+
+    collector_note_alloc(ptr);
+    g_alloc_debt += size;
+
+    return ptr;
+}
+
+static void *chunk_realloc(void *ptr, size_t new_size)
+{
+    void *new_ptr;
+    size_t old_size, copy_size;
+    slab_page *p_page;
+    chunk_node *p_node;
+
+    alloc_pace();
+
+    p_page = slab_find_page(ptr);
+    if (p_page != NULL) // slab objects can't be passed to `realloc()`
+    {
+        if (new_size == 0)
+        {
+            slab_free(ptr);
+
+            return NULL;
+        }
+
+        if (new_size <= slab_object_size(p_page)) // still fits in its object so nothing has to move
+        {
+            return ptr;
+        }
+
+        new_ptr = chunk_alloc(new_size, false, p_page->atomic ? &g_atomic_layout : NULL, 0); // objects from atomic pages stay atomic
+        if (new_ptr == NULL)
+        {
+            collector_run(true); // likely not to improve the situation but not much else we can do
+
+            new_ptr = chunk_alloc(new_size, false, p_page->atomic ? &g_atomic_layout : NULL, 0);
+            if (new_ptr == NULL)
+            {
+                return NULL;
+            }
+        }
+
+        memcpy(new_ptr, ptr, slab_object_size(p_page));
+        collector_shade(new_ptr, new_ptr + slab_object_size(p_page), p_page->atomic ? &g_atomic_layout : NULL); // the copy wasn't there when marking started
+        weak_move(ptr, new_ptr); // the finalizer and weak references follow the object to its new chunk
+        slab_free(ptr);
+
+        return new_ptr;
+    }
+
+    if (ptr == NULL) // `realloc(NULL, new_size)` acts as `malloc(new_size)`
+    {
+        if (new_size == 0)
+        {
+            return NULL;
+        }
+
+        new_ptr = chunk_alloc(new_size, false, NULL, 0);
+        if (new_ptr == NULL)
+        {
+            collector_run(true); // likely not to improve the situation but not much else we can do
+
+            new_ptr = chunk_alloc(new_size, false, NULL, 0);
+        }
+
+        return new_ptr;
+    }
+
+    p_node = table_lookup(ptr);
+    if (g_mark_active && p_node != NULL && p_node->indexed) // the collector may still scan the chunk, so it can't be moved or freed yet
+    {
+        if (new_size == 0)
+        {
+            collector_defer_free(ptr);
+
+            return NULL;
+        }
+
+        new_ptr = chunk_copy_alloc(p_node, new_size);
+        if (new_ptr == NULL)
+        {
+            return NULL;
+        }
+
+        copy_size = (new_size < p_node->size) ? new_size : p_node->size;
+        memcpy(new_ptr, ptr, copy_size);
+        collector_merge_barriers(); // so that the remembered words of the chunk move along with it
+        remset_move(ptr, new_ptr, copy_size);
+        collector_shade(new_ptr, new_ptr + copy_size, p_node->p_layout);
+        weak_move(ptr, new_ptr);
+        collector_defer_free(ptr);
+
+        return new_ptr;
+    }
+
+    collector_merge_barriers(); // so that the remembered words of the chunk move along with it
+    old_size = (p_node != NULL) ? p_node->size : 0;
+    new_ptr = compact_realloc(ptr, old_size, new_size);
+
+    // Handle any errors from `realloc()`
+    if (new_ptr == NULL && new_size != 0) // if `new_size` is zero, `realloc()` returning `NULL` is actually the intended effect
+    {
+        collector_run(true); // likely not to improve the situation but not much else we can do
+
+        new_ptr = compact_realloc(ptr, old_size, new_size);
+        if (new_ptr == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    if (new_size == 0) // `realloc(ptr, 0)` acts as `free(ptr)` and returns `NULL`
+    {
+        table_remove(ptr);
+
+        return NULL;
+    }
+
+    // The chunk keeps its `chunk_node` and generation whether or not it moved, so only growth counts as new allocation
+    if (p_node == NULL) // wasn't allocated through `gclib`
+    {
+        table_insert(new_ptr, new_size, NULL, false);
+        collector_note_alloc(new_ptr);
+        g_alloc_debt += new_size;
+    }
+    else
+    {
+        table_resize_node(p_node, new_ptr, new_size); // the node was looked up once, before `realloc()`
+        if (new_size > old_size)
+        {
+            g_alloc_debt += new_size - old_size;
+        }
+    }
+
+    if (p_node != NULL && new_ptr != ptr) // its remembered words may have moved to where an incremental collection already scanned the remembered set
+    {
+        collector_shade(new_ptr, new_ptr + ((new_size < old_size) ? new_size : old_size), p_node->p_layout);
+        collector_note_alloc(new_ptr);
+    }
+
+    return new_ptr;
+}
+
+/* Allocate a chunk of `new_size` bytes to copy the chunk of `*p_node` into, which takes over its layout, site, generation and age (unless it is large enough to be mapped on its own, which keeps it in generation 0). Return the new chunk, or `NULL` if there wasn't enough memory. */
+static void *chunk_copy_alloc(const chunk_node *p_node, size_t new_size)
+{
+    void *new_ptr;
+    bool large;
+    chunk_node *p_new_node;
+
+    // Not taken from a slab page even if it would fit, since slab objects are always in generation 0
+    large = g_large_threshold > 0 && new_size >= g_large_threshold;
+    new_ptr = large ? large_alloc(new_size, false) : malloc(new_size);
+    if (new_ptr == NULL)
+    {
+        return NULL;
+    }
+
+    p_new_node = table_insert(new_ptr, new_size, p_node->p_layout, large);
+    if (p_new_node == NULL)
+    {
+        if (large)
+        {
+            large_free(new_ptr, new_size);
+        }
+        else
+        {
+            free(new_ptr);
+        }
+
+        return NULL;
+    }
+
+    if (!large)
+    {
+        table_set_gen(p_new_node, p_node->gen);
+        p_new_node->age = p_node->age;
+        p_new_node->site = p_node->site;
+    }
+
+    collector_note_alloc(new_ptr);
+    g_alloc_debt += new_size;
+
+    return new_ptr;
+}
+
+static bool chunk_is_start(const void *ptr)
+{
+    size_t object_size;
+    chunk_node *p_node;
+    slab_page *p_page;
+
+    p_page = slab_find_page(ptr);
+    if (p_page != NULL)
+    {
+        object_size = slab_object_size(p_page);
+
+        return slab_is_allocated(ptr) && (size_t) (ptr - p_page->base) % object_size == 0;
+    }
+
+    p_node = (ptr != NULL) ? table_lookup(ptr) : NULL;
+
+    return p_node != NULL && !p_node->dead;
+}
+
+static bool chunk_contains(const void *ptr)
+{
+    const void *start, *low;
+    chunk_node *p_node;
+
+    if (slab_find_page(ptr) != NULL)
+    {
+        return slab_is_allocated(ptr);
+    }
+
+    if (ptr < g_table_min_ptr || g_table_max_ptr <= ptr)
+    {
+        return false;
+    }
+
+    start = large_find(ptr);
+    p_node = (start != NULL) ? table_lookup(start) : NULL;
+    if (p_node != NULL && ptr < start + p_node->size)
+    {
+        return !p_node->dead;
+    }
+
+    // Chunks don't overlap, so only the closest one starting at or below `ptr` can contain it. Every other chunk starts
+    // at a multiple of the alignment of `malloc()`, and none is larger than `g_table_max_size`, which bounds the walk.
+    low = ((size_t) (ptr - g_table_min_ptr) > g_table_max_size) ? ptr - g_table_max_size : g_table_min_ptr;
+    for (start = (const void *) ((uintptr_t) ptr & ~(uintptr_t) (COMPACT_ALIGN - 1)); start >= low; start -= COMPACT_ALIGN)
+    {
+        p_node = table_lookup(start);
+        if (p_node != NULL)
+        {
+            return !p_node->dead && ptr < start + p_node->size;
+        }
+    }
+
+    return false;
+}
+
+static void finalizers_run(bool all)
+{
+    size_t count, idx;
+    weak_final batch[WEAK_FINAL_BATCH];
+
+    // Finalizers are taken a batch at a time and run without holding the lock, so that they can use `gclib` themselves
+    // and other threads can allocate in the meantime. One that allocates doesn't run any more finalizers in turn.
+    if (g_finalizing || __atomic_load_n(&g_weak_final_len, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    g_finalizing = true;
+
+    count = WEAK_FINAL_BATCH;
+    while (count == WEAK_FINAL_BATCH) // a batch that isn't full emptied the queue
+    {
+        pthread_mutex_lock(&g_gclib_lock);
+        count = gclib_ready() ? weak_take_pending(batch, WEAK_FINAL_BATCH) : 0;
+        pthread_mutex_unlock(&g_gclib_lock);
+
+        // The chunks stay alive while `batch` on this thread's stack references them
+        for (idx = 0; idx < count; idx++)
+        {
+            batch[idx].finalizer(batch[idx].ptr, batch[idx].p_arg);
+        }
+
+        if (!all)
+        {
+            break;
+        }
+    }
+
+    g_finalizing = false;
 
     return;
 }
@@ -5,8 +5,80 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/* Describes which words of a type may hold references to chunks, for use with `gclib_alloc_typed()`. */
+typedef struct gclib_layout
+{
+    size_t size;              // size of the type in bytes (a multiple of `sizeof(void *)`); arrays of it repeat the layout every `size` bytes
+    const uint64_t *p_bitmap; // bit `i % 64` of `p_bitmap[i / 64]` is set if the `i`th word of the type may hold a reference; `NULL` if none do
+} gclib_layout;
+
+#define GCLIB_GENERATIONS 4    // most generations chunks can be promoted through (see `gclib_set_generations()`)
+#define GCLIB_PAUSE_BUCKETS 24 // number of buckets in `gclib_stats.pause_histogram`
+
+/* The regions of memory that collections scan as roots. */
+typedef enum gclib_root_region
+{
+    GCLIB_ROOT_DATA,          // the initialized data and BSS segments
+    GCLIB_ROOT_REGISTERED,    // the ranges registered with `gclib_add_root()`
+    GCLIB_ROOT_STACKS,        // the stacks and registers of the registered threads
+    GCLIB_ROOT_REMSET,        // the words remembered by `gclib_write_ptr()`
+    GCLIB_ROOT_REGION_MEMORY, // the memory allocated from the regions created with `gclib_region_create()`
+    GCLIB_ROOT_REGIONS
+} gclib_root_region;
+
+/* What the collector did to the chunks of one generation, summed over every collection so far. */
+typedef struct gclib_gen_stats
+{
+    unsigned long collections; // number of collections that included the generation
+    size_t marked_chunks;      // chunks found reachable (slab objects count towards generation 0)
+    size_t marked_bytes;
+    size_t freed_chunks;       // chunks found unreachable or freed by the program while they were being marked
+    size_t freed_bytes;
+    size_t promoted_chunks;    // reachable chunks moved on to the next generation
+    size_t promoted_bytes;
+    uint64_t mark_ns;          // time from the start to the end of marking of the collections whose oldest generation this is
+    uint64_t sweep_ns;         // time spent sweeping by the collections whose oldest generation this is
+} gclib_gen_stats;
+
+/* Statistics about every collection since `gclib_init()`, as returned by `gclib_get_stats()`. */
+typedef struct gclib_stats
+{
+    unsigned int generations;                          // number of generations in use; the statistics of the others stay zero
+    gclib_gen_stats gens[GCLIB_GENERATIONS];
+    size_t root_words[GCLIB_ROOT_REGIONS];             // words scanned in each root region
+    size_t compacted_chunks;                           // chunks of the oldest generation moved by compacting collections
+    size_t compacted_bytes;
+    size_t pinned_chunks;                              // chunks of the oldest generation that compacting collections left in place because a word that may not be a reference pointed into them
+    size_t finalized_chunks;                           // unreachable chunks whose finalizers collections queued to be run
+    size_t cleared_weak_refs;                          // weak references collections cleared because their chunks were unreachable
+    size_t pretenured_chunks;                          // chunks allocated straight into the oldest generation because the chunks from their allocation site mostly survived
+    size_t pretenured_bytes;
+    unsigned long pauses;                              // number of times the collector held up an allocation or a call to `gclib_collect()` since the last `gclib_reset_pause_stats()`, if any
+    uint64_t pause_ns_total;
+    uint64_t pause_ns_max;
+    unsigned long pause_histogram[GCLIB_PAUSE_BUCKETS]; // bucket `i` counts the pauses shorter than 2^`i` microseconds that didn't fit in bucket `i - 1`; the last bucket also counts all longer ones
+} gclib_stats;
+
+/* When a callback set with `gclib_set_cycle_callback()` is called. */
+typedef enum gclib_cycle_event
+{
+    GCLIB_CYCLE_START, // a collection is about to start marking
+    GCLIB_CYCLE_END    // a collection finished sweeping
+} gclib_cycle_event;
+
+typedef void (*gclib_cycle_callback)(gclib_cycle_event event, const gclib_stats *p_stats, void *p_arg);
+
+typedef void (*gclib_finalizer)(void *ptr, void *p_arg);
+
+/* A reference to a chunk that doesn't keep it from being collected, as returned by `gclib_weak_create()`. */
+typedef struct gclib_weak gclib_weak;
+
+/* Memory that is allocated piece by piece and freed all at once, as returned by `gclib_region_create()`. */
+typedef struct gclib_region gclib_region;
+
 /*
 #### Synopsis
 Initialize `gclib`.
@@ -61,6 +133,47 @@ defined as `#define true 1` and `#define false 0` so the numerical literals can
 */
 bool gclib_ready(void);
 
+/*
+#### Synopsis
+Register the calling thread so that it can use `gclib` and so that its stack and registers are scanned by every
+collection.
+
+#### Description
+`gclib_register_thread()` must be called by every thread other than the one that called `gclib_init()` (which is
+registered automatically) before it calls any other `gclib` function or stores references to chunks anywhere but in
+chunks and global variables. A collection started by any thread stops all other registered threads with a signal,
+scans their stacks from the innermost frame to the end of the stack along with the registers they were stopped with,
+and resumes them once marking is done. While slab allocation is enabled, registered threads also get pages of their
+own for each size class, which they allocate from without taking any lock. A registered thread must call
+`gclib_unregister_thread()` before it exits and must not block the signals `SIGPWR` and `SIGXCPU`, which are used to
+stop and resume it. Calling it again from a thread that is already registered does nothing.
+
+#### Parameters
+None.
+
+#### Return Value
+`true` if the thread is registered, or `false` if `gclib` isn't ready or there wasn't enough memory to register it.
+*/
+bool gclib_register_thread(void);
+
+/*
+#### Synopsis
+Unregister the calling thread, which must have been registered with `gclib_register_thread()`.
+
+#### Description
+`gclib_unregister_thread()` removes the calling thread from the set of threads that are stopped and scanned by each
+collection and makes the unused objects of its slab pages available to other threads again. Chunks that are only
+referenced from the thread's stack are freed by a later collection. The thread must not use `gclib` after this
+until it registers again.
+
+#### Parameters
+None.
+
+#### Return Value
+None.
+*/
+void gclib_unregister_thread(void);
+
 /*
 #### Synopsis
 Dynamically allocate a chunk of memory subject to garbage collection.
@@ -87,6 +200,117 @@ equal to zero, `gclib_alloc()` will return `NULL`. Otherwise, a return value of
 */
 void *gclib_alloc(size_t size, bool zeroed);
 
+/*
+#### Synopsis
+Dynamically allocate a chunk of memory subject to garbage collection that never holds references to other chunks.
+
+#### Description
+`gclib_alloc_atomic()` behaves like `gclib_alloc()`, except that the collector never scans the contents of the chunk.
+This suits chunks that only hold data such as strings, numbers or other raw bytes: scanning them is wasted work, and
+any bytes in them that happen to look like a pointer would keep some other chunk alive for no reason. A reference to a
+chunk that is stored only in an atomic chunk does not keep it alive. Resizing the chunk with `gclib_realloc()` keeps it
+atomic.
+
+#### Parameters
+`size` - The size in bytes of the memory chunk to be allocated.
+`zeroed` - The option to initialize all bytes in the allocated chunk to zero.
+
+#### Return Value
+The same as for `gclib_alloc()`.
+*/
+void *gclib_alloc_atomic(size_t size, bool zeroed);
+
+/*
+#### Synopsis
+Dynamically allocate a chunk of memory subject to garbage collection whose references are only found in known places.
+
+#### Description
+`gclib_alloc_typed()` behaves like `gclib_alloc()`, except that the collector only scans the words of the chunk that
+`*p_layout` marks as possibly holding a reference. The chunk is treated as an array of the type described by the
+layout, so the same layout can be used for a single object and for arrays of any length. The layout is not copied and
+must stay valid for as long as any chunk allocated with it exists, which is easiest to ensure by making it a constant
+with static storage duration. Resizing the chunk with `gclib_realloc()` keeps its layout. Typed chunks are never
+carved out of slab pages.
+
+#### Parameters
+`size` - The size in bytes of the memory chunk to be allocated.
+`zeroed` - The option to initialize all bytes in the allocated chunk to zero.
+`p_layout` - The layout of the type stored in the chunk. If `NULL`, the whole chunk is scanned as with `gclib_alloc()`,
+and if its `p_bitmap` is `NULL`, none of it is as with `gclib_alloc_atomic()`.
+
+#### Return Value
+The same as for `gclib_alloc()`.
+*/
+void *gclib_alloc_typed(size_t size, bool zeroed, const gclib_layout *p_layout);
+
+/*
+#### Synopsis
+Dynamically allocate a number of chunks of the same size subject to garbage collection in a single call.
+
+#### Description
+`gclib_alloc_batch()` behaves like calling `gclib_alloc(size, zeroed)` `count` times, storing each chunk in
+`p_out[i]`, but locks `gclib` once, checks whether a collection is due once for the whole batch, and makes room in its
+table of chunks for all of them at once. Programs that allocate many small objects at the same time, such as the nodes
+of a tree that is being parsed, spend most of their time on this per-call overhead otherwise. Each chunk can be
+resized and freed on its own like any other.
+
+`p_out` can be a local or global array, or memory from `malloc()` that the program may free afterwards. It can also be a
+chunk of any generation (or lie anywhere within one), in which case the chunks are stored into it as if with
+`gclib_write_ptr()`.
+
+#### Parameters
+`count` - The number of chunks to allocate.
+`size` - The size in bytes of each chunk. A size of 0 stores `NULL` for every chunk.
+`zeroed` - The option to initialize all bytes in the allocated chunks to zero.
+`p_out` - Where to store the `count` chunks.
+
+#### Return Value
+The number of chunks stored in `p_out`, which is less than `count` only if the system ran out of memory partway
+through. The entries after them are left untouched.
+*/
+size_t gclib_alloc_batch(size_t count, size_t size, bool zeroed, void **p_out);
+
+/*
+#### Synopsis
+Dynamically allocate a number of chunks of different sizes subject to garbage collection in a single call.
+
+#### Description
+`gclib_alloc_batch_sizes()` behaves like `gclib_alloc_batch()`, except that `p_out[i]` gets a chunk of `p_sizes[i]`
+bytes.
+
+#### Parameters
+`count` - The number of chunks to allocate.
+`p_sizes` - The size in bytes of each chunk. Sizes of 0 store `NULL` for their chunks.
+`zeroed` - The option to initialize all bytes in the allocated chunks to zero.
+`p_out` - Where to store the `count` chunks.
+
+#### Return Value
+The same as for `gclib_alloc_batch()`.
+*/
+size_t gclib_alloc_batch_sizes(size_t count, const size_t *p_sizes, bool zeroed, void **p_out);
+
+/*
+#### Synopsis
+Dynamically allocate a chunk of memory subject to garbage collection on behalf of a given allocation site.
+
+#### Description
+`gclib_alloc_site()` behaves like `gclib_alloc()`, except that the chunk counts towards the allocation site `site`
+instead of the code that called it when pretenuring is enabled (see `gclib_set_pretenuring()`). Every other allocation
+function counts its chunks towards the address it returns to, so code that allocates through a helper function of its
+own has all of its chunks counted towards that helper, however differently the chunks from its callers live. Passing on
+`__builtin_return_address(0)` from within the helper, or a constant per kind of object, tells them apart again.
+
+#### Parameters
+`size` - The size in bytes of the memory chunk to be allocated.
+`zeroed` - The option to initialize all bytes in the allocated chunk to zero.
+`site` - Any number that identifies the allocation site, such as an address within the code or the data segment. A
+value of 0 leaves the chunk out of pretenuring altogether.
+
+#### Return Value
+The same as for `gclib_alloc()`.
+*/
+void *gclib_alloc_site(size_t size, bool zeroed, uintptr_t site);
+
 /*
 #### Synopsis
 Resize a chunk of dynamically allocated memory subject to garbage collection.
@@ -94,7 +318,8 @@ Resize a chunk of dynamically allocated memory subject to garbage collection.
 #### Description
 `gclib_realloc()` acts as a wrapper around `realloc()` by passing the `ptr` and `new_size` arguments to it.
 As such, it mirrors the behavior of this standard-library function. The result is stored internally for `gclib` to
-use later on during the garbage collection process.
+use later on during the garbage collection process. A resized chunk stays in the generation it was already in,
+whether or not it had to be moved, and only the bytes it grew by count towards the next collection.
 
 #### Parameters
 `ptr` - The pointer to the memory chunk that is to be resized. Note that `ptr` must have been returned by either
@@ -130,6 +355,578 @@ None.
 */
 void gclib_free(void *ptr);
 
+/*
+#### Synopsis
+Store a pointer into a chunk of dynamically allocated memory subject to garbage collection so that collections of only
+the younger generations can see it.
+
+#### Description
+`gclib_write_ptr()` performs `*(void **) dst = val` and remembers `dst` as a word that may hold a reference from an
+older chunk to a younger one. Collections that leave older generations out don't scan those generations at all, so a
+younger chunk that is only referenced from an older one would otherwise be freed while still in use. Remembered words
+are scanned as extra roots during such collections and are forgotten once they no longer point to a younger chunk
+(or once the chunk containing them is freed). References that are stored into chunks directly (or with `memcpy()`
+and similar functions) are only guaranteed to be seen by collections that include the generation of the chunk they
+are stored in, which `gclib_force_collect()` always does. While incremental collection is enabled with
+`gclib_set_pause_target()`, `gclib_write_ptr()` also marks `val` if a collection is under way, which makes it mandatory
+for every reference that is stored into a chunk.
+
+#### Parameters
+`dst` - The address of the pointer-sized, pointer-aligned word to store to. It should lie within a chunk returned by
+`gclib_alloc()` or `gclib_realloc()` (or in memory that is scanned anyway, such as a global variable).
+`val` - The pointer to store.
+
+#### Return Value
+None.
+*/
+void gclib_write_ptr(void *dst, void *val);
+
+/*
+#### Synopsis
+Register a range of memory that holds references to chunks so that it is scanned by every collection.
+
+#### Description
+`gclib_add_root()` adds the `size` bytes starting at `ptr` to the root set. This is needed for memory that the
+collector doesn't scan by itself but that may hold the only reference to a chunk, such as a buffer allocated with the
+standard-library `malloc()` or memory that was mapped by the program. It also makes it possible to turn off scanning of
+the data and BSS segments with `gclib_set_data_scan()` and register just the global variables that actually hold
+references. The range is scanned conservatively like the rest of the root set: every aligned pointer-sized word within
+it is treated as a potential reference. The same range may be registered more than once, in which case it has to be
+unregistered as many times.
+
+#### Parameters
+`ptr` - The start of the range. Any bytes before the first pointer-aligned address are skipped.
+`size` - The size of the range in bytes.
+
+#### Return Value
+`true` if the range was registered, or `false` if `ptr` is `NULL` or there wasn't enough memory to do so.
+*/
+bool gclib_add_root(void *ptr, size_t size);
+
+/*
+#### Synopsis
+Unregister a range of memory previously registered with `gclib_add_root()`.
+
+#### Description
+`gclib_remove_root()` removes the range starting at `ptr` from the root set. Chunks that were only referenced from it
+are freed by a later collection. This should be done before the memory of the range itself is freed or goes out of
+scope.
+
+#### Parameters
+`ptr` - The start of the range, as passed to `gclib_add_root()`. Nothing happens if no range starts at `ptr`.
+
+#### Return Value
+None.
+*/
+void gclib_remove_root(void *ptr);
+
+/*
+#### Synopsis
+Register a function to be called once a chunk has become unreachable, before it is freed.
+
+#### Description
+`gclib_register_finalizer()` lets a chunk clean up after itself, such as by closing a file descriptor or unmapping
+memory that it owns. Once a collection finds the chunk at `ptr` unreachable, rather than freeing it, the collection
+keeps it (and everything it references) alive and queues `finalizer(ptr, p_arg)` to be called. Queued finalizers are
+never called while the other threads are stopped: after each allocation that doesn't come straight out of the calling
+thread's slab pages, up to 64 of them are called before `gclib_alloc()` (or `gclib_realloc()`) returns, and
+`gclib_collect()` and `gclib_force_collect()` call every queued finalizer before returning. Finalizers are called
+without any of `gclib`'s locks held, so they may allocate (without running further finalizers themselves), but they
+should not take locks that the code allocating may be holding.
+
+Each finalizer is called once, after which the chunk is freed by a later collection of the generation it was promoted
+to, unless the finalizer stored a reference to it somewhere reachable. Finalizers of chunks that become unreachable at
+the same time are called in no particular order, even if one of the chunks references another. Freeing a chunk with
+`gclib_free()` drops its finalizer without calling it, and finalizers that are still queued when `gclib_cleanup()` is
+called are never called.
+
+#### Parameters
+`ptr` - The start of a chunk allocated through `gclib`.
+`finalizer` - The function to call, which replaces any finalizer that was previously registered for the chunk, or
+`NULL` to remove it.
+`p_arg` - An argument that is passed on to `finalizer`, or `NULL`.
+
+#### Return Value
+`true` if the finalizer was registered, or `false` if `ptr` isn't the start of a chunk or there wasn't enough memory.
+*/
+bool gclib_register_finalizer(void *ptr, gclib_finalizer finalizer, void *p_arg);
+
+/*
+#### Synopsis
+Create a weak reference to a chunk, which doesn't keep the chunk from being collected.
+
+#### Description
+`gclib_weak_create()` returns a handle through which the chunk at `ptr` can be reached for as long as it is reachable
+in some other way. Once a collection finds the chunk unreachable, the reference is cleared and `gclib_weak_get()`
+returns `NULL` from then on. References to a chunk with a finalizer are cleared as soon as the finalizer is queued.
+This makes it possible to build caches that shrink as the collector frees their entries, for example by keeping the
+values of a table as weak references and dropping the entries whose references were cleared.
+
+The handle is allocated with `malloc()`, which `gclib` never scans, and it stays valid until it is passed to
+`gclib_weak_free()`. References follow their chunks when they are moved by `gclib_realloc()` or by compaction, and are
+cleared when their chunks are freed with `gclib_free()`.
+
+#### Parameters
+`ptr` - The start of a chunk allocated through `gclib`.
+
+#### Return Value
+The weak reference, or `NULL` if `ptr` isn't the start of a chunk or there wasn't enough memory.
+*/
+gclib_weak *gclib_weak_create(void *ptr);
+
+/*
+#### Synopsis
+Get the chunk a weak reference refers to, if it is still alive.
+
+#### Description
+`gclib_weak_get()` returns the chunk that `*p_weak` was created for, unless a collection has found it unreachable since
+(or it was freed). The returned pointer is an ordinary reference that keeps the chunk alive for as long as the program
+holds it.
+
+#### Parameters
+`p_weak` - The weak reference, as returned by `gclib_weak_create()`.
+
+#### Return Value
+The chunk, or `NULL` if the reference was cleared.
+*/
+void *gclib_weak_get(const gclib_weak *p_weak);
+
+/*
+#### Synopsis
+Free a weak reference created with `gclib_weak_create()`.
+
+#### Description
+`gclib_weak_free()` frees the memory of `*p_weak`, whether or not the reference was cleared. The chunk it referred to
+isn't affected.
+
+#### Parameters
+`p_weak` - The weak reference to free. Nothing happens if it is `NULL`.
+
+#### Return Value
+None.
+*/
+void gclib_weak_free(gclib_weak *p_weak);
+
+/*
+#### Synopsis
+Create a region to allocate memory from that is freed all at once instead of being garbage-collected.
+
+#### Description
+`gclib_region_create()` returns a handle to an empty region. Memory allocated from it with `gclib_region_alloc()` is
+handed out one allocation after the other from large blocks, none of which the collector tracks as chunks: there is no
+per-allocation bookkeeping, nothing for collections to mark or sweep, and no way to free an allocation on its own.
+Everything is freed at once by `gclib_region_destroy()`. This suits objects that all die together, such as those
+built while handling a single request. If `scanned` is set, every collection scans the memory allocated from the
+region for references (as it does the ranges registered with `gclib_add_root()`), so chunks that are only referenced
+from the region are kept alive until it is destroyed. Otherwise, the memory must never hold the only reference to a
+chunk. A region must only be allocated from by one thread at a time.
+
+#### Parameters
+`scanned` - The option to have collections scan the memory allocated from the region for references to chunks.
+
+#### Return Value
+The region, or `NULL` if there wasn't enough memory. It must be destroyed with `gclib_region_destroy()`.
+*/
+gclib_region *gclib_region_create(bool scanned);
+
+/*
+#### Synopsis
+Allocate memory from a region created with `gclib_region_create()`.
+
+#### Description
+`gclib_region_alloc()` takes the next `size` bytes (rounded up to a multiple of 16) of the current block of
+`*p_region`, which doesn't take any lock, and only gets a new block from the system once the current one is full.
+Allocations larger than 16KB are given blocks of their own. The memory stays valid until the region is destroyed and
+must not be passed to `gclib_realloc()` or `gclib_free()`. References to it don't keep anything alive.
+
+#### Parameters
+`p_region` - The region to allocate from.
+`size` - The size in bytes of the memory to allocate.
+`zeroed` - The option to initialize all bytes in the allocated memory to zero.
+
+#### Return Value
+A pointer to the allocated memory, which is aligned like memory from `malloc()`, or `NULL` if `size` is 0 or there
+wasn't enough memory.
+*/
+void *gclib_region_alloc(gclib_region *p_region, size_t size, bool zeroed);
+
+/*
+#### Synopsis
+Free a region created with `gclib_region_create()` along with all memory allocated from it.
+
+#### Description
+`gclib_region_destroy()` gives every block of `*p_region` back at once. Collections stop scanning its memory, so the
+chunks that were only referenced from it can be collected.
+
+#### Parameters
+`p_region` - The region to free. Nothing happens if it is `NULL`.
+
+#### Return Value
+None.
+*/
+void gclib_region_destroy(gclib_region *p_region);
+
+/*
+#### Synopsis
+Choose whether the initialized data and BSS segments are scanned as part of the root set.
+
+#### Description
+`gclib_set_data_scan()` enables or disables the automatic scan of the program's global variables that each collection
+does. Programs with large static tables that never hold references to chunks spend most of each collection scanning
+them, and any value in them that happens to look like a pointer keeps a chunk alive for no reason. With the scan
+disabled, only the stack and the ranges registered with `gclib_add_root()` are scanned, so every global variable that
+holds a reference to a chunk must be registered. The scan is enabled by default.
+
+#### Parameters
+`enabled` - Whether the data and BSS segments should be scanned (`true`) or not (`false`).
+
+#### Return Value
+None.
+*/
+void gclib_set_data_scan(bool enabled);
+
+/*
+#### Synopsis
+Set how long each allocation may spend marking during an incremental collection.
+
+#### Description
+`gclib_set_pause_target()` turns on incremental collection, in which a collection that is due only starts marking
+and then continues a little at a time during each later call to `gclib_alloc()` and `gclib_realloc()`, so that pauses
+no longer grow with the size of the live heap. Once there is nothing left to mark, a short final pause stops every
+registered thread and scans the stacks, registers, and global variables once more before sweeping as usual. Building
+the sorted index of the chunks being collected still happens in one go when the collection starts. If the program
+allocates a whole collection's worth of memory before marking finishes, the rest of the marking is done at once.
+
+While incremental collection is enabled, every reference that is stored into a chunk **must** be stored with
+`gclib_write_ptr()` (including the initialization of newly allocated chunks), which marks the referenced chunk if a
+collection is under way. Chunks freed with `gclib_free()` or resized with `gclib_realloc()` while marking is under
+way are only given back to the system by the sweep. `gclib_collect()` and `gclib_force_collect()` finish a collection
+that is under way. Incremental collection is disabled by default.
+
+#### Parameters
+`microseconds` - The longest time each allocation may spend marking, or 0 to mark all at once (and finish a collection
+that is under way with the next allocation).
+
+#### Return Value
+None.
+*/
+void gclib_set_pause_target(unsigned int microseconds);
+
+/*
+#### Synopsis
+Choose whether collections mark on a background thread while the program keeps running.
+
+#### Description
+`gclib_set_concurrent()` turns on concurrent collection, in which a collection that is due only builds the index of the
+chunks being collected, after which a dedicated background thread marks from the global variables while every thread of
+the program keeps allocating without waiting for it. Once the background thread is done, the next allocation stops every
+registered thread for a short final pause that scans the stacks and registers, the registered root ranges, and the
+chunks allocated in the meantime, along with the marked chunks that the program wrote to while the background thread was
+running, before sweeping as usual. The pages written to are found through the soft-dirty bits that Linux keeps in
+`/proc/self/pagemap`; on kernels without them, every marked chunk is scanned again, which keeps collections correct but
+makes the final pause about as long as marking the whole heap. Unlike incremental collection, this puts no extra
+requirements on how references are stored, so `gclib_write_ptr()` is only needed where it always is. If the program
+allocates a whole collection's worth of memory before the background thread is done, the rest of the marking is done at
+once. Concurrent collection takes precedence over the pause target set with `gclib_set_pause_target()` and is disabled
+by default.
+
+#### Parameters
+`enabled` - Whether collections should mark on the background thread (`true`) or during the pause (`false`).
+
+#### Return Value
+`true` if the setting took effect, or `false` if the background thread couldn't be started.
+*/
+bool gclib_set_concurrent(bool enabled);
+
+/*
+#### Synopsis
+Choose whether small allocations are served from `gclib`'s own size-segregated pages instead of `malloc()`.
+
+#### Description
+`gclib_set_slab_alloc()` enables or disables slab allocation for all later calls to `gclib_alloc()` and
+`gclib_realloc()`. When enabled, requests of up to 2048 bytes are rounded up to one of a fixed set of size classes and
+carved out of 64 KiB pages that hold only objects of that class. Such chunks carry no per-chunk bookkeeping: whether
+they are allocated or reachable is tracked in a bitmap belonging to their page, which makes allocating them and
+sweeping them considerably cheaper than going through `malloc()` and `free()`. Chunks allocated from pages are
+collected along with generation 0 and are never promoted. Chunks that were allocated before the setting is changed
+are unaffected and may still be resized and freed as usual.
+
+#### Parameters
+`enabled` - Whether small allocations should come from pages (`true`) or `malloc()`/`calloc()` (`false`). Slab
+allocation is disabled by default.
+
+#### Return Value
+None.
+*/
+void gclib_set_slab_alloc(bool enabled);
+
+/*
+#### Synopsis
+Choose how large an allocation has to be for its chunk to be mapped from the system on its own.
+
+#### Description
+`gclib_set_large_threshold()` sets the size from which later calls to `gclib_alloc()` and its variants map a chunk of
+whole pages with `mmap()` instead of going through `malloc()`. Such chunks are given back to the system once they are
+freed (apart from up to 16MB of them, which are kept to be reused by later large allocations) and are resized with
+`mremap()` without copying their contents. They stay in generation 0 for as long as they are reachable, so they never
+count towards the budget of an older generation, and they are looked up in an index of their own so that words that
+merely fall between them and the rest of the heap are still rejected cheaply. Chunks that were allocated before the
+threshold is changed stay where they were allocated, and a chunk resized past the threshold by `gclib_realloc()` is not
+moved to its own pages.
+
+#### Parameters
+`bytes` - Size (in bytes) of the smallest allocation that is mapped on its own, or 0 to allocate every chunk through
+`malloc()`. The default threshold is 1MB.
+
+#### Return Value
+None.
+*/
+void gclib_set_large_threshold(size_t bytes);
+
+/*
+#### Synopsis
+Choose whether collections of every generation move the chunks of the oldest generation closer together.
+
+#### Description
+`gclib_set_compaction()` enables or disables mostly-copying compaction of the oldest generation, which otherwise stays
+wherever `malloc()` put it for as long as it is reachable. Every collection that includes the oldest generation and
+marks all at once (which `gclib_force_collect()` always does) then copies the reachable chunks of that generation into
+1MB regions of their own, one after the other, and rewrites the references to them. Only references stored in the words
+that the layout of a chunk from `gclib_alloc_typed()` describes are rewritten, so a chunk that any other word points
+into (a local or global variable, a register, or a chunk allocated with `gclib_alloc()`) is pinned where it is for that
+collection. Chunks larger than 128KB are never moved. Regions that become sparse are evacuated by later collections in
+turn, and each region is given back to the system once nothing is left in it. Incremental and concurrent collections
+never move chunks. While compaction is enabled, a word that a layout describes must never hold a value that merely looks
+like an address within a chunk, since it would be rewritten as well, and the program must not rely on the address of a
+chunk it only references through such words staying the same, such as by hashing it.
+
+#### Parameters
+`enabled` - Whether collections should compact the oldest generation. Compaction is disabled by default.
+
+#### Return Value
+None.
+*/
+void gclib_set_compaction(bool enabled);
+
+/*
+#### Synopsis
+Set how many bytes a generation may accumulate before it is collected.
+
+#### Description
+`gclib_set_gen_budget()` sets the budget of a single generation. Generation 0 is collected once `bytes` bytes have
+been allocated through `gclib` since the last collection, while each older generation is collected once the chunks
+promoted into it take up more than `bytes` bytes in total. Collecting a generation always collects every younger
+generation as well. Budgets are minimums: with a nonzero growth percentage (see `gclib_set_growth_percent()`), a
+generation may grow beyond its budget when the live heap is large. Smaller budgets mean more frequent but shorter
+collections and a smaller heap; larger ones trade memory for less time spent collecting.
+
+#### Parameters
+`gen` - The generation whose budget to set, from 0 (the youngest) to `GCLIB_GENERATIONS - 1`. The budget of a generation
+that isn't in use (see `gclib_set_generations()`) takes effect once it is. Other values are ignored.
+`bytes` - The new budget in bytes. Every generation defaults to a budget of 1GB.
+
+#### Return Value
+None.
+*/
+void gclib_set_gen_budget(unsigned int gen, size_t bytes);
+
+/*
+#### Synopsis
+Set how many generations chunks are promoted through.
+
+#### Description
+`gclib_set_generations()` sets the number of generations that the heap is divided into, up to `GCLIB_GENERATIONS`. With
+fewer generations, surviving chunks reach the oldest one (which is collected the least often) sooner; with more, they
+are held in younger generations for longer, where they are freed by cheaper collections if they die after all. A single
+generation makes every collection a full one. The new number takes effect when the next collection starts, at which
+point chunks in generations that are no longer in use are moved into the new oldest one. It is meant to be called right
+after `gclib_init()`, along with `gclib_set_gen_budget()` for each generation in use.
+
+#### Parameters
+`count` - The number of generations, from 1 to `GCLIB_GENERATIONS`. Other values are ignored. The default is 3.
+
+#### Return Value
+None.
+*/
+void gclib_set_generations(unsigned int count);
+
+/*
+#### Synopsis
+Set how many collections a chunk has to survive before it is promoted to the next generation.
+
+#### Description
+`gclib_set_tenure_age()` sets the number of collections of its generation that a reachable chunk stays in that
+generation for before it is promoted. Each chunk counts the collections it survived in its current generation, and the
+count starts over once it is promoted. With the default of 1, every chunk that survives a collection is promoted, so
+chunks that merely happened to be live when a collection started end up in an older generation, where they linger until
+that generation is collected. A higher age keeps such chunks where they are freed soonest, at the cost of marking the
+chunks that do live long a few more times before they are promoted. Chunks in the oldest generation and chunks mapped on
+their own (see `gclib_set_large_threshold()`) are never promoted. The new age takes effect when the next collection
+starts.
+
+#### Parameters
+`collections` - The number of collections a chunk has to survive, from 1 to 255. Other values are ignored.
+
+#### Return Value
+None.
+*/
+void gclib_set_tenure_age(unsigned int collections);
+
+/*
+#### Synopsis
+Enable or disable allocating the chunks from sites whose chunks mostly survive straight into the oldest generation.
+
+#### Description
+`gclib_set_pretenuring()` has each chunk remember the site it was allocated from, which is the address the allocation
+function returns to (or the site passed to `gclib_alloc_site()`), and counts how many of the chunks from each site
+survive the first collection they take part in. Once 90% or more of the last 256 such chunks from a site survived, its
+later chunks start out in the oldest generation instead of generation 0, skipping the collections that would only mark
+and promote them. One in 16 of them is still allocated into generation 0 so that its survival rate keeps being measured,
+and a site stops being pretenured as soon as a later sample of its chunks falls below the rate again.
+
+Until they would have been promoted out of generation 0 (see `gclib_set_tenure_age()`), collections still scan the
+chunks allocated into the oldest generation in full, so that references stored into them without `gclib_write_ptr()`
+while they are being initialized are still found. Up to 255 sites are tracked; chunks from any further sites, chunks
+carved out of slab pages (see `gclib_set_slab_alloc()`) and chunks mapped on their own (see
+`gclib_set_large_threshold()`) are never pretenured. Neither is any chunk while a single generation is in use.
+
+#### Parameters
+`enabled` - Whether chunks from sites whose chunks mostly survive are pretenured. Disabled by default.
+
+#### Return Value
+None.
+*/
+void gclib_set_pretenuring(bool enabled);
+
+/*
+#### Synopsis
+Set how far the heap may grow, relative to what survived the last collection, before it is collected again.
+
+#### Description
+`gclib_set_growth_percent()` makes collections proportional to the size of the live heap in the same way as Go's
+`GOGC`. After each collection, generation 0 is next collected once the number of bytes allocated reaches `percent`
+percent of the bytes that survived (and each older generation once it grows by `percent` percent over what was left in
+it after its last collection), unless its budget from `gclib_set_gen_budget()` is larger.
+
+#### Parameters
+`percent` - The allowed growth as a percentage of the live heap. A value of 0 leaves collections paced by the
+generations' budgets alone. Defaults to 100.
+
+#### Return Value
+None.
+*/
+void gclib_set_growth_percent(unsigned int percent);
+
+/*
+#### Synopsis
+Set a soft limit on the memory used by the process, which makes collections come sooner as it gets close.
+
+#### Description
+`gclib_set_heap_limit()` keeps the resident set size of the process (as reported by `/proc/self/statm`) below `bytes`
+where it can. After each collection, generation 0 is next collected once half of what is left below the limit has been
+allocated, however large its budget or growth percentage would allow, and once the process is within 10% of the limit,
+every collection includes every generation. Collections still leave at least 4MB of allocations in between, so the
+limit is soft: if the live heap outgrows it, the program keeps running, and collects often.
+
+By default, the limit is 90% of the memory limit of the cgroup the process belongs to (`memory.max` for cgroup v2 or
+`memory.limit_in_bytes` for v1), so that a program in a container collects before it is killed for running out of
+memory, or none if there is no cgroup limit.
+
+Whether or not there is a limit, memory freed by collections is given back to the system after sweeps that free 64MB
+or more (and after every sweep near the limit), so that the resident set size shrinks along with the heap.
+
+#### Parameters
+`bytes` - The number of bytes the process should stay below. A value of 0 removes the limit.
+
+#### Return Value
+None.
+*/
+void gclib_set_heap_limit(size_t bytes);
+
+/*
+#### Synopsis
+Set the number of threads that take part in the mark phase of each collection.
+
+#### Description
+`gclib_set_mark_threads()` starts (or stops) a pool of helper threads that mark reachable chunks alongside the thread
+that triggered the collection. The root set is split into slices that are dealt out between the threads, and each
+thread that runs out of work steals half of the work another thread has made available, so that even a single long
+linked structure keeps every thread busy for as long as possible. The program itself remains stopped while the
+collector runs; only the collector's own work is spread across cores. This is mainly worthwhile for large heaps, since
+starting and synchronizing the threads has a small fixed cost per collection.
+
+#### Parameters
+`threads` - The total number of marking threads, including the one that triggered the collection (at most 64). A
+value of 0 or 1 stops the pool so that marking happens on the collecting thread alone, which is the default.
+
+#### Return Value
+`true` if the setting took effect, or `false` if the helper threads couldn't be started, in which case marking happens
+on the collecting thread alone.
+*/
+bool gclib_set_mark_threads(unsigned int threads);
+
+/*
+#### Synopsis
+Get statistics about what the garbage collector did so far.
+
+#### Description
+`gclib_get_stats()` copies the running totals the collector keeps into `*p_stats`. For each generation, they include the
+number of collections that included it, the number of chunks (and bytes) that were found reachable, freed, and promoted,
+and the time spent marking and sweeping by the collections whose oldest generation it is, measured with a monotonic
+clock. The counts of a collection are added as its lazy sweep goes along, so they are only complete once it finishes.
+The time spent marking runs from the start of a collection until marking is done, so for incremental and concurrent
+collections it includes the time the program ran in between. Also included are the number of words scanned in each root
+region and a histogram of the pauses the collector caused, where a pause is any stretch of time that an allocation (or
+`gclib_collect()` and similar functions) spent collecting instead of allocating: the whole of a collection that marks at
+once, each step of an incremental collection or of a lazy sweep, and the final pause of an incremental or concurrent
+collection.
+
+#### Parameters
+`p_stats` - Where to store the statistics.
+
+#### Return Value
+None.
+*/
+void gclib_get_stats(gclib_stats *p_stats);
+
+/*
+#### Synopsis
+Start counting pauses over.
+
+#### Description
+`gclib_reset_pause_stats()` sets the number of pauses, their total and maximum length, and the pause histogram
+returned by `gclib_get_stats()` back to zero, so that the longest pause of a stretch of the program can be measured on
+its own. The other statistics keep their running totals.
+
+#### Parameters
+None.
+
+#### Return Value
+None.
+*/
+void gclib_reset_pause_stats(void);
+
+/*
+#### Synopsis
+Set a function to be called at the start and end of each collection.
+
+#### Description
+`gclib_set_cycle_callback()` makes the collector call `callback(GCLIB_CYCLE_START, p_stats, p_arg)` right before
+each collection starts marking and `callback(GCLIB_CYCLE_END, p_stats, p_arg)` once it finished sweeping, which may be
+during a later allocation since the sweep is lazy. `p_stats` points to the statistics as of then, which are the same
+as those returned by `gclib_get_stats()`. The callback is called from whichever thread triggered the work, while
+`gclib` is locked, so it must not call any `gclib` function and should return quickly since every other thread that
+allocates waits for it. It is never called while the other threads are stopped.
+
+#### Parameters
+`callback` - The function to call, or `NULL` to stop calling one.
+`p_arg` - Passed on to `callback` as its last argument.
+
+#### Return Value
+None.
+*/
+void gclib_set_cycle_callback(gclib_cycle_callback callback, void *p_arg);
+
 /*
 #### Synopsis
 Explicitly run the garbage collector in order to free unreachable dynamically allocated memory chunks.
@@ -137,8 +934,9 @@ Explicitly run the garbage collector in order to free unreachable dynamically al
 #### Description
 `gclib_collect()` runs a standard cycle of the garbage collector in an effort to collect memory chunks allocated
 through `gclib_alloc()` and `gclib_realloc()`. However, note that because each generation of chunks is only
-swept through after a certain number of bytes have been allocated, not much will be collected if only a small
-amount of memory has been allocated through `gclib` functions.
+swept through after a certain number of bytes have been allocated (see `gclib_set_gen_budget()` and
+`gclib_set_growth_percent()`), nothing will be collected if only a small amount of memory has been allocated through
+`gclib` functions since the last collection.
 
 #### Parameters
 None.
@@ -158,7 +956,8 @@ COLLECTOR'S NATURAL CYCLES.
 #### Description
 `gclib_force_collect()` runs a cycle of the garbage collector but with the condition that all generations are
 swept through. The result is that any chunks allocated through `gclib_alloc()` and `gclib_realloc()` that are
-determined to be unreachable are freed.
+determined to be unreachable are freed. Unlike regular collections, which leave most of the sweeping to later
+allocations, the chunks are freed before `gclib_force_collect()` returns.
 
 #### Parameters
 None.